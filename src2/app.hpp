@@ -2,8 +2,12 @@
 #pragma once
 #include "core.hpp"
 #include "graphics.hpp"
+#include "profile.hpp"
 
 
+// ALIASED is 1 pixel bresenham, ANTIALIASED blends by pixel coverage
+enum struct RenderMode { ALIASED, ANTIALIASED };
+
 struct AppVideo {
   SDL_Window* window = nullptr;
   SDL_Renderer* renderer = nullptr;
@@ -11,10 +15,21 @@ struct AppVideo {
   int w_pixels = 0;
   int h_pixels = 0;
   double density = 1.0;
+  RenderMode render_mode = RenderMode::ALIASED;
+};
+
+// world to screen: pixel = (P - origin) * zoom
+struct Camera {
+  static constexpr double min_zoom = 1e-3;
+  static constexpr double max_zoom = 1e3;
+  Vec2 origin{};
+  double zoom = 1.0;
 };
 
 struct AppInput {
-  Vec2 mouse{};
+  Vec2 mouse{}; // world coordinates
+  Vec2 mouse_screen{}; // window pixels
+  bool panning = false;
   bool mouse_left_down = false;
   bool mouse_right_down = false;
   bool mouse_click = false;
@@ -41,8 +56,12 @@ struct App {
   AppVideo video;
   AppInput input;
   AppContext context;
+  Camera camera;
+  Profiler profiler;
 };
 
 namespace app {
-
+Vec2 screen_to_world(const Camera &camera, const Vec2 &P);
+// zoom by factor while keeping the world point under the cursor fixed
+void zoom_at(App &app, const double factor);
 } // namespace app
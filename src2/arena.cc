@@ -0,0 +1,84 @@
+#include "arena.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> g_heap_allocations{0};
+} // namespace
+
+// global allocation counter, the arena is there to keep it flat per frame
+void *operator new(size_t size) {
+	g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+void *operator new[](size_t size) {
+	return ::operator new(size);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+void *ArenaUpstream::do_allocate(size_t bytes, size_t alignment) {
+	overflow_bytes += bytes;
+	return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+void ArenaUpstream::do_deallocate(void *p, size_t bytes, size_t alignment) {
+	std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+bool ArenaUpstream::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+	return this == &other;
+}
+
+namespace arena {
+namespace detail {
+FrameArena &local() {
+	thread_local FrameArena arena;
+	return arena;
+}
+
+void grow(FrameArena &arena, size_t size) {
+	arena.resource.reset();
+	arena.block = std::make_unique<std::byte[]>(size);
+	arena.block_size = size;
+	arena.resource.emplace(arena.block.get(), arena.block_size, &arena.upstream);
+}
+} // namespace detail
+
+std::pmr::memory_resource *frame() {
+	FrameArena &arena = detail::local();
+	if (!arena.resource) {
+		detail::grow(arena, FrameArena::initial_size);
+	}
+	return &*arena.resource;
+}
+
+void reset_frame() {
+	FrameArena &arena = detail::local();
+	if (!arena.resource) {
+		return;
+	}
+	if (arena.upstream.overflow_bytes > 0) {
+		size_t size = arena.block_size;
+		while (size < arena.block_size + arena.upstream.overflow_bytes) {
+			size *= 2;
+		}
+		detail::grow(arena, size);
+	} else {
+		arena.resource->release();
+	}
+	arena.upstream.overflow_bytes = 0;
+}
+
+size_t frame_block_size() {
+	return detail::local().block_size;
+}
+
+uint64_t heap_allocations() {
+	return g_heap_allocations.load(std::memory_order_relaxed);
+}
+} // namespace arena
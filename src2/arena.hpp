@@ -0,0 +1,31 @@
+// arena.hpp
+#pragma once
+#include "core.hpp"
+
+// counts the bytes the arena had to take from the heap in a frame
+struct ArenaUpstream : std::pmr::memory_resource {
+	size_t overflow_bytes = 0;
+	void *do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+// bump allocator for scratch buffers that live at most one frame. memory
+// is handed out from one block and rewound at the end of the frame, a
+// frame that overflowed the block grows it for the next frame
+struct FrameArena {
+	static constexpr size_t initial_size = size_t{1} << 20;
+	std::unique_ptr<std::byte[]> block;
+	size_t block_size = 0;
+	ArenaUpstream upstream;
+	std::optional<std::pmr::monotonic_buffer_resource> resource;
+};
+
+namespace arena {
+// scratch memory for this thread, valid until reset_frame
+std::pmr::memory_resource *frame();
+void reset_frame();
+size_t frame_block_size();
+// operator new calls since program start
+uint64_t heap_allocations();
+} // namespace arena
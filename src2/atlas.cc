@@ -0,0 +1,157 @@
+#include "atlas.hpp"
+#include "nodes.hpp"
+#include "parallel.hpp"
+#include <charconv>
+#include <numeric>
+
+namespace atlas {
+namespace detail {
+int64_t quantize(const double value) {
+	return std::llround(value / quantum);
+}
+
+uint64_t hash(const ShapeType type, const double *values, const uint32_t count) {
+	auto mix = [](uint64_t h, const uint64_t v) {
+		h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+		return h;
+	};
+	uint64_t h = mix(static_cast<uint64_t>(type), count);
+	for (uint32_t i = 0; i < count; i++) {
+		h = mix(h, static_cast<uint64_t>(quantize(values[i])));
+	}
+	return h;
+}
+
+bool same(const AtlasEntry &entry, const ShapeType type, const double *values,
+					const uint32_t count) {
+	if (entry.example.type != type || entry.values.size() != count) {
+		return false;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (quantize(entry.values[i]) != quantize(values[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void add(std::vector<AtlasEntry> &out, AtlasLookup &lookup,
+				 const Relation &relation, const double *values, const uint64_t hash,
+				 const uint32_t count) {
+	std::vector<uint32_t> &bucket = lookup[hash];
+	for (uint32_t k : bucket) {
+		if (same(out[k], relation.type, values, relation.count)) {
+			out[k].count += count;
+			return;
+		}
+	}
+	bucket.push_back(static_cast<uint32_t>(out.size()));
+	AtlasEntry entry{hash, count, relation, {values, values + relation.count}};
+	entry.example.begin = 0;
+	out.push_back(std::move(entry));
+}
+
+void collect(const RelationBatch &batch, std::vector<AtlasEntry> &out) {
+	AtlasLookup lookup;
+	for (const Relation &relation : batch.relations) {
+		if (relation.count < 2) {
+			continue;
+		}
+		const double *values = batch.values.data() + relation.begin;
+		add(out, lookup, relation, values, hash(relation.type, values, relation.count),
+				1);
+	}
+}
+} // namespace detail
+
+void build(Shapes &shapes, Atlas &out) {
+	if (!shapes.node_index.built) {
+		nodes::detail::index_nodes(shapes);
+	}
+	std::vector<int> ids(shapes.by_id.size());
+	std::iota(ids.begin(), ids.end(), 0);
+	const size_t n_chunks =
+		(ids.size() + gen::batch_chunk - 1) / gen::batch_chunk;
+
+	std::vector<std::vector<AtlasEntry>> partial(n_chunks);
+	std::vector<size_t> n_relations(n_chunks, 0);
+	const Shapes &scene = shapes;
+	util::parallel_for(n_chunks, [&](const size_t k) {
+		RelationBatch batch;
+		gen::detail::batch_chunk_relations(scene, ids, k * gen::batch_chunk,
+			std::min(ids.size(), (k + 1) * gen::batch_chunk), batch);
+		n_relations[k] = batch.relations.size();
+		detail::collect(batch, partial[k]);
+	});
+
+	out = Atlas{};
+	for (const size_t n : n_relations) {
+		out.n_relations += n;
+	}
+	AtlasLookup lookup;
+	for (const auto &entries : partial) {
+		for (const AtlasEntry &entry : entries) {
+			detail::add(out.entries, lookup, entry.example, entry.values.data(),
+									entry.hash, entry.count);
+		}
+	}
+	std::stable_sort(out.entries.begin(), out.entries.end(),
+		[](const AtlasEntry &a, const AtlasEntry &b) {
+			if (a.count != b.count) {
+				return a.count > b.count;
+			}
+			return a.values.size() > b.values.size();
+		});
+}
+
+bool write(const Atlas &atlas, const std::string &path) {
+	std::ofstream out{path};
+	if (!out) {
+		return false;
+	}
+	std::string buffer;
+	char number[32];
+	auto append = [&](const auto value) {
+		auto [end, ec] = std::to_chars(number, number + sizeof(number), value);
+		buffer.append(number, end);
+	};
+	for (size_t rank = 0; rank < atlas.entries.size(); rank++) {
+		const AtlasEntry &entry = atlas.entries[rank];
+		const Relation &example = entry.example;
+		append(rank + 1);
+		buffer += ' ';
+		append(entry.count);
+		buffer += ' ';
+		append(example.shape_id);
+		buffer += example.type == ShapeType::LINE ? " L " :
+							example.type == ShapeType::CIRCLE ? " C " : " A ";
+		append(example.origin.x);
+		buffer += ' ';
+		append(example.origin.y);
+		buffer += example.clockwise ? " 1" : " 0";
+		for (double value : entry.values) {
+			buffer += ' ';
+			append(value);
+		}
+		buffer += '\n';
+		if (buffer.size() >= size_t{1} << 20) {
+			out.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+	}
+	out.write(buffer.data(), buffer.size());
+	return static_cast<bool>(out);
+}
+
+bool calculate(Shapes &shapes, const std::string &path) {
+	Atlas atlas;
+	build(shapes, atlas);
+	if (!write(atlas, path)) {
+		std::cerr << "couldn't write " << path << std::endl;
+		return false;
+	}
+	cout << "atlas: " << atlas.entries.size() << " distinct of "
+		<< atlas.n_relations << " relations to " << path << endl;
+	return true;
+}
+} // namespace atlas
@@ -0,0 +1,54 @@
+// atlas.hpp
+#pragma once
+#include "core.hpp"
+#include "gen.hpp"
+#include "shapes.hpp"
+
+// one distinct relation sequence of the drawing. count is how many
+// (origin, shape, direction) give it, example is the first of them in id
+// order
+struct AtlasEntry {
+	uint64_t hash = 0;
+	uint32_t count = 0;
+	Relation example {};
+	std::vector<double> values;
+};
+
+// entries from the most to the least common
+struct Atlas {
+	std::vector<AtlasEntry> entries;
+	size_t n_relations = 0;
+};
+
+// distinct entries by hash, a hash can hold more than one entry
+using AtlasLookup = std::unordered_map<uint64_t, std::vector<uint32_t>>;
+
+namespace atlas {
+// values that round to the same multiple are the same relation
+constexpr double quantum = 1e-9;
+namespace detail {
+int64_t quantize(const double value);
+// over the shape type and the quantized values
+uint64_t hash(const ShapeType type, const double *values, const uint32_t count);
+bool same(const AtlasEntry &entry, const ShapeType type, const double *values,
+					const uint32_t count);
+// counts the sequence in out, a new entry copies the values
+void add(std::vector<AtlasEntry> &out, AtlasLookup &lookup,
+				 const Relation &relation, const double *values, const uint64_t hash,
+				 const uint32_t count);
+// distinct sequences of one batch in the order they first appear
+void collect(const RelationBatch &batch, std::vector<AtlasEntry> &out);
+} // namespace detail
+// relations of every shape from every origin and direction of the batch,
+// see gen::batch_relations, deduplicated and ranked by count and then by
+// length. relations with nothing beyond their origin are left out. each
+// chunk of gen::batch_chunk shapes is computed and deduplicated on one
+// core, only its distinct relations are kept. the chunks are merged in id
+// order so the result does not depend on the number of threads
+void build(Shapes &shapes, Atlas &out);
+// one line per entry: rank, count, example shape id, L, C or A, origin,
+// 1 if clockwise, values
+bool write(const Atlas &atlas, const std::string &path);
+// build and write, key M
+bool calculate(Shapes &shapes, const std::string &path);
+} // namespace atlas
@@ -0,0 +1,309 @@
+#include "batch.hpp"
+#include "arena.hpp"
+#include "nodes.hpp"
+#include "relstream.hpp"
+#include "serialize.hpp"
+#include <charconv>
+#include <filesystem>
+#include <sstream>
+
+namespace batch {
+namespace detail {
+bool parse_point(const std::string &text, Vec2 &out) {
+	std::istringstream in{text};
+	char comma = 0;
+	return static_cast<bool>(in >> out.x >> comma >> out.y) && comma == ',';
+}
+
+bool parse_shapes(const std::string &text, std::vector<BatchShape> &out) {
+	std::istringstream in{text};
+	std::string item;
+	while (std::getline(in, item, ',')) {
+		BatchShape shape;
+		std::string direction;
+		size_t colon = item.find(':');
+		if (colon != std::string::npos) {
+			direction = item.substr(colon + 1);
+			item.resize(colon);
+		}
+		auto [end, ec] = std::from_chars(item.data(), item.data() + item.size(),
+																		 shape.id);
+		if (ec != std::errc{} || end != item.data() + item.size() ||
+				(direction != "" && direction != "cw" && direction != "ccw")) {
+			return false;
+		}
+		shape.clockwise = direction == "cw";
+		out.push_back(shape);
+	}
+	return !out.empty();
+}
+
+bool parse_script(const std::string &path, std::vector<BatchSelection> &out) {
+	std::ifstream in{path};
+	if (!in) {
+		std::cerr << "couldn't open " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	size_t line_number = 0;
+	while (std::getline(in, line)) {
+		line_number++;
+		line.resize(std::min(line.size(), line.find('#')));
+		std::istringstream words{line};
+		std::string directive;
+		if (!(words >> directive)) {
+			continue;
+		}
+		bool ok = false;
+		if (directive == "origin") {
+			BatchSelection selection;
+			ok = static_cast<bool>(words >> selection.origin.x >> selection.origin.y);
+			out.push_back(selection);
+		} else if (directive == "shape" && !out.empty()) {
+			BatchShape shape;
+			std::string direction;
+			ok = static_cast<bool>(words >> shape.id);
+			if (ok && words >> direction) {
+				ok = direction == "cw" || direction == "ccw";
+				shape.clockwise = direction == "cw";
+			}
+			out.back().shapes.push_back(shape);
+		}
+		if (!ok) {
+			std::cerr << path << ":" << line_number << ": can't read \"" << line
+				<< "\"" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool parse_args(int argc, char *argv[], BatchOptions &out) {
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		auto has = [&](const int n) {
+			if (i + n >= argc) {
+				std::cerr << arg << " needs " << n << " arguments" << std::endl;
+				return false;
+			}
+			return true;
+		};
+		if (arg == "--gen") {
+			if (!has(2)) { return false; }
+			BatchSelection selection;
+			if (!parse_point(argv[i + 1], selection.origin) ||
+					!parse_shapes(argv[i + 2], selection.shapes)) {
+				std::cerr << "--gen takes <x,y> <id[:cw|:ccw],...>" << std::endl;
+				return false;
+			}
+			out.selections.push_back(selection);
+			i += 2;
+		} else if (arg == "--script") {
+			if (!has(1) || !parse_script(argv[i + 1], out.selections)) {
+				return false;
+			}
+			i += 1;
+		} else if (arg == "--out-dir") {
+			if (!has(1)) { return false; }
+			out.out_dir = argv[++i];
+		} else if (arg == "--image") {
+			if (!has(1)) { return false; }
+			out.image_format = argv[++i];
+			if (out.image_format != "png" && out.image_format != "ppm") {
+				std::cerr << "--image takes png or ppm" << std::endl;
+				return false;
+			}
+		} else if (arg == "--size") {
+			if (!has(2)) { return false; }
+			out.image_settings.width = std::atoi(argv[i + 1]);
+			out.image_settings.height = std::atoi(argv[i + 2]);
+			if (out.image_settings.width <= 0 || out.image_settings.height <= 0) {
+				std::cerr << "invalid image size" << std::endl;
+				return false;
+			}
+			i += 2;
+		} else if (arg == "--aa") {
+			out.image_settings.mode = RenderMode::ANTIALIASED;
+		} else if (arg == "--quantize") {
+			if (!has(1)) { return false; }
+			int bits = std::atoi(argv[++i]);
+			if (bits < 0 || bits >= 32) {
+				std::cerr << "--quantize takes 0 to 31 fractional bits" << std::endl;
+				return false;
+			}
+			out.encoding = RelationEncoding::Q32;
+			out.frac_bits = static_cast<uint32_t>(bits);
+		} else if (arg == "--verbose") {
+			out.verbose = true;
+		} else if (arg.starts_with("--")) {
+			std::cerr << "unknown option " << arg << std::endl;
+			return false;
+		} else {
+			out.scenes.push_back(arg);
+		}
+	}
+	for (const BatchSelection &selection : out.selections) {
+		if (selection.shapes.empty()) {
+			std::cerr << "a selection without shapes" << std::endl;
+			return false;
+		}
+	}
+	return !out.scenes.empty();
+}
+
+bool find_origin(const Shapes &shapes, const Vec2 &P, Node &out) {
+	double best = origin_snap;
+	bool found = false;
+	for (const std::vector<Node> *nodes : {&shapes.ixn_points, &shapes.def_points}) {
+		for (const Node &node : *nodes) {
+			double distance = vec2::distance(node.P, P);
+			if (!node.pflags.concealed && distance <= best) {
+				best = distance;
+				out = node;
+				found = true;
+			}
+		}
+		if (found) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool select(Shapes &shapes, const BatchSelection &selection,
+						GenShapes &gen_shapes) {
+	gen::clear(shapes, gen_shapes);
+	if (!find_origin(shapes, selection.origin, gen_shapes.origin)) {
+		std::cerr << "no node at " << selection.origin.x << "," << selection.origin.y
+			<< std::endl;
+		return false;
+	}
+	gen_shapes.origin_set = true;
+	const Vec2 start = gen_shapes.origin.P;
+	for (const BatchShape &shape : selection.shapes) {
+		if (shape.id < 0 || static_cast<size_t>(shape.id) >= shapes.by_id.size() ||
+				!shapes::id_match(gen_shapes.origin.ids, shape.id)) {
+			std::cerr << "shape " << shape.id << " is not on the origin" << std::endl;
+			return false;
+		}
+		const ShapeSlot slot = shapes.by_id[shape.id];
+		if (slot.type == ShapeType::LINE) {
+			gen_shapes.lines.push_back(GenLine{shape.id, start, start});
+			gen_shapes.selection_order.emplace_back(ShapeType::LINE,
+																							gen_shapes.lines.size() - 1);
+			continue;
+		}
+		// a point a quarter turn from the start in the direction of travel
+		Vec2 C {};
+		if (slot.type == ShapeType::CIRCLE) {
+			C = shapes.circles.get(slot.handle)->geom.C;
+		} else if (slot.type == ShapeType::ARC) {
+			C = shapes.arcs.get(slot.handle)->geom.C;
+		}
+		Vec2 s = start - C;
+		Vec2 dir = C + (shape.clockwise ? Vec2{-s.y, s.x} : Vec2{s.y, -s.x});
+		if (slot.type == ShapeType::CIRCLE) {
+			gen_shapes.circles.push_back(GenCircle{shape.id, start, dir});
+			gen_shapes.selection_order.emplace_back(ShapeType::CIRCLE,
+																							gen_shapes.circles.size() - 1);
+		} else if (slot.type == ShapeType::ARC) {
+			gen_shapes.arcs.push_back(GenArc{shape.id, start, dir});
+			gen_shapes.selection_order.emplace_back(ShapeType::ARC,
+																							gen_shapes.arcs.size() - 1);
+		}
+	}
+	return true;
+}
+
+std::string output_base(const BatchOptions &options, const std::string &scene) {
+	std::filesystem::path path{scene};
+	std::filesystem::path dir = options.out_dir.empty() ?
+		path.parent_path() : std::filesystem::path{options.out_dir};
+	return (dir / path.filename()).string();
+}
+
+bool run_scene(const BatchOptions &options, const std::string &scene) {
+	Shapes shapes;
+	if (!serialize::load_appstate(shapes, scene)) {
+		return false;
+	}
+	nodes::rebuild(shapes);
+	const std::string base = output_base(options, scene);
+
+	bool ok = true;
+	const std::string path = base + (options.selections.empty() ? ".rel" :
+																									 ".gen.rel");
+	RelationWriter writer;
+	if (!relstream::begin(writer, path, options.encoding, options.frac_bits)) {
+		std::cerr << "couldn't open " << path << std::endl;
+		return false;
+	}
+	if (options.selections.empty()) {
+		gen::calculate_batch_relations(shapes, writer);
+	} else {
+		GenShapes gen_shapes;
+		for (const BatchSelection &selection : options.selections) {
+			if (!select(shapes, selection, gen_shapes)) {
+				std::cerr << "in " << scene << std::endl;
+				ok = false;
+				uint32_t depth = 0;
+				for (const BatchShape &shape : selection.shapes) {
+					Relation relation{shape.id, ShapeType::NONE, selection.origin,
+						shape.clockwise, 0, 0, depth++};
+					relstream::write(writer, relation, nullptr);
+				}
+				continue;
+			}
+			gen::calculate_relations(shapes, gen_shapes, writer, options.verbose);
+		}
+	}
+	ok = relstream::finish(writer) && ok;
+
+	if (!options.image_format.empty()) {
+		ExportSettings settings = options.image_settings;
+		settings.format = options.image_format == "ppm" ? ImageFormat::PPM :
+																											 ImageFormat::PNG;
+		image::fit_scene(settings, shapes);
+		ok = image::export_scene(shapes, base + "." + options.image_format,
+														 settings) && ok;
+	}
+	return ok;
+}
+} // namespace detail
+
+void print_usage(const char *program) {
+	std::cerr << "usage: " << program << " --batch [options] <save_file>...\n"
+		<< "  --gen <x,y> <id[:cw|:ccw],...>  gen selection, can be repeated\n"
+		<< "  --script <file>                 gen selections, origin and shape lines\n"
+		<< "  --out-dir <dir>                 default is next to the save file\n"
+		<< "  --image <png|ppm>               also render the scene\n"
+		<< "  --size <width> <height>         of the image\n"
+		<< "  --aa                            antialiased image\n"
+		<< "  --quantize <bits>               fixed point values, bits after the point\n"
+		<< "  --verbose                       print the relations\n"
+		<< "relations go to <save_file>.gen.rel with gen selections, otherwise\n"
+		<< "all relations to <save_file>.rel, --relations-to-text reads both"
+		<< std::endl;
+}
+
+int run(int argc, char *argv[]) {
+	BatchOptions options;
+	if (!detail::parse_args(argc, argv, options)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	auto begin = std::chrono::steady_clock::now();
+	size_t failed = 0;
+	for (const std::string &scene : options.scenes) {
+		if (!detail::run_scene(options, scene)) {
+			failed++;
+		}
+		arena::reset_frame();
+	}
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - begin).count();
+	cout << options.scenes.size() - failed << " of " << options.scenes.size()
+		<< " scenes in " << seconds << " s" << endl;
+	return failed == 0 ? 0 : 1;
+}
+} // namespace batch
@@ -0,0 +1,65 @@
+// batch.hpp
+#pragma once
+#include "core.hpp"
+#include "gen.hpp"
+#include "image.hpp"
+#include "relstream.hpp"
+#include "shapes.hpp"
+
+// one gen selection given on the command line or in a script: the origin
+// as a point that is snapped to the closest node, then the shapes in
+// order, circles and arcs with their direction
+struct BatchShape {
+	int id {-1};
+	bool clockwise = false;
+};
+struct BatchSelection {
+	Vec2 origin {};
+	std::vector<BatchShape> shapes;
+};
+
+struct BatchOptions {
+	std::vector<std::string> scenes;
+	std::vector<BatchSelection> selections;
+	// next to the scene if empty
+	std::string out_dir;
+	// no image if empty, otherwise png or ppm
+	std::string image_format;
+	ExportSettings image_settings;
+	// Q32 values with frac_bits fractional bits, see relstream.hpp
+	RelationEncoding encoding = RelationEncoding::F64;
+	uint32_t frac_bits = RelationStreamHeader::default_frac_bits;
+	bool verbose = false;
+};
+
+// loads every scene, computes its nodes and writes relations without SDL
+// video. with selections their records follow each other in one relation
+// stream, a selection that fails leaves an empty record per shape.
+// otherwise the relations of every shape go into a stream of their own
+namespace batch {
+// nodes further from the given origin than this are not taken
+constexpr double origin_snap = 1e-2;
+namespace detail {
+// "x,y", false if it does not parse
+bool parse_point(const std::string &text, Vec2 &out);
+// "id" or "id:cw" / "id:ccw", several separated by commas
+bool parse_shapes(const std::string &text, std::vector<BatchShape> &out);
+// one directive per line, # starts a comment
+//   origin <x> <y>       starts a selection
+//   shape <id> [cw|ccw]  adds a shape to it
+bool parse_script(const std::string &path, std::vector<BatchSelection> &out);
+bool parse_args(int argc, char *argv[], BatchOptions &out);
+// the node closest to P within origin_snap, ixn before def nodes
+bool find_origin(const Shapes &shapes, const Vec2 &P, Node &out);
+// gen shapes as a click on every shape would give, false with a message
+// if a shape does not exist or does not pass through the origin
+bool select(Shapes &shapes, const BatchSelection &selection,
+						GenShapes &gen_shapes);
+// out_dir or the directory of the scene, with the file name of the scene
+std::string output_base(const BatchOptions &options, const std::string &scene);
+bool run_scene(const BatchOptions &options, const std::string &scene);
+} // namespace detail
+void print_usage(const char *program);
+// --batch [options] <save_file>..., exit code of the process
+int run(int argc, char *argv[]);
+} // namespace batch
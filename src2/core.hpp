@@ -7,7 +7,17 @@
 #include <numbers>
 #include <chrono>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <array>
 #include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <string>
+#include <limits>
+#include <bitset>
 #include <SDL3/SDL.h>
 
 using namespace std;
@@ -1,24 +1,71 @@
 #include "draw.hpp"
+#include "arena.hpp"
+#include "spatial.hpp"
+#include "instances.hpp"
+#include "layers.hpp"
 namespace draw {
+namespace detail {
 // world to screen conversion
-void set_pixel(App &app, uint32_t *pixel_buf, int x, int y, uint32_t color) {
-	if (x >= 0 && y >= 0 && x < app.video.w_pixels && y < app.video.h_pixels) {
-		pixel_buf[x + y * app.video.w_pixels] = color;
+Vec2 to_screen(const Canvas &canvas, const Vec2 &P) {
+	return (P - canvas.origin) * canvas.scale;
+}
+
+void set_pixel(Canvas &canvas, int x, int y, uint32_t color) {
+	if (x >= 0 && y >= 0 && x < canvas.width && y < canvas.height) {
+		canvas.pixels[x + y * canvas.width] = color;
+	}
+}
+
+// liang-barsky, clip the segment to the canvas so bresenham only walks the
+// visible part, matters for tiles of large exports
+bool clip_to_canvas(const Canvas &canvas, Vec2 &A, Vec2 &B) {
+	double t0 = 0.0, t1 = 1.0;
+	Vec2 v = B - A;
+	double p[4] = {-v.x, v.x, -v.y, v.y};
+	double q[4] = {A.x + 1.0, canvas.width - A.x, A.y + 1.0, canvas.height - A.y};
+	for (int i = 0; i < 4; i++) {
+		if (std::abs(p[i]) < gk::epsilon) {
+			if (q[i] < 0.0) { return false; }
+			continue;
+		}
+		double t = q[i] / p[i];
+		if (p[i] < 0.0) {
+			if (t > t1) { return false; }
+			t0 = std::max(t0, t);
+		} else {
+			if (t < t0) { return false; }
+			t1 = std::min(t1, t);
+		}
 	}
+	B = A + v * t1;
+	A = A + v * t0;
+	return true;
 }
 
-void plot_line(App& app, uint32_t *pixel_buf, const Line2 &line, uint32_t color) {
-	int x0 = std::round(line.A.x);
-	int y0 = std::round(line.A.y);
-	int x1 = std::round(line.B.x);
-	int y1 = std::round(line.B.y);
+bool bounds_on_canvas(const Canvas &canvas, const Vec2 &C, double r) {
+	return C.x + r >= -1.0 && C.y + r >= -1.0 &&
+				 C.x - r <= canvas.width && C.y - r <= canvas.height;
+}
+
+void plot_line(Canvas &canvas, const Line2 &line, uint32_t color) {
+	Vec2 A = to_screen(canvas, line.A);
+	Vec2 B = to_screen(canvas, line.B);
+	if (!clip_to_canvas(canvas, A, B)) { return; }
+	if (canvas.mode == RenderMode::ANTIALIASED) {
+		plot_line_aa(canvas, A, B, color);
+		return;
+	}
+	int x0 = std::round(A.x);
+	int y0 = std::round(A.y);
+	int x1 = std::round(B.x);
+	int y1 = std::round(B.y);
 
   int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
   int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
   int err = dx + dy, e2; /* error value e_xy */
 
   for (;;) { /* loop */
-    set_pixel(app, pixel_buf, x0, y0, color);
+    set_pixel(canvas, x0, y0, color);
     e2 = 2 * err;
     if (e2 >= dy) { /* e_xy+e_x > 0 */
       if (x0 == x1)
@@ -35,23 +82,30 @@ void plot_line(App& app, uint32_t *pixel_buf, const Line2 &line, uint32_t color)
   }
 }
 
-void plot_arc(App &app, uint32_t *pixel_buf, const Arc2 &arc, uint32_t color) {
-	int xm = std::round(arc.C.x);
-	int ym = std::round(arc.C.y);
-	int r = std::round(arc.radius());
+void plot_arc(Canvas &canvas, const Arc2 &arc, uint32_t color) {
+	// uniform scale keeps the angles, only center and radius change
+	Vec2 C = to_screen(canvas, arc.C);
+	if (!bounds_on_canvas(canvas, C, arc.radius() * canvas.scale)) { return; }
+	if (canvas.mode == RenderMode::ANTIALIASED) {
+		plot_ring_aa(canvas, C, arc.radius() * canvas.scale, &arc, color);
+		return;
+	}
+	int xm = std::round(C.x);
+	int ym = std::round(C.y);
+	int r = std::round(arc.radius() * canvas.scale);
   int x = -r, y = 0, err = 2 - 2 * r; /* bottom left to top right */
   do {
-		if (arc2::angle_on_arc(arc, vec2::get_angle(arc.C, Vec2{static_cast<double>(xm - x), static_cast<double>(ym + y)}))) {
-			set_pixel(app, pixel_buf, xm - x, ym + y, color); //   I. Quadrant +x +y
+		if (arc2::angle_on_arc(arc, vec2::get_angle(C, Vec2{static_cast<double>(xm - x), static_cast<double>(ym + y)}))) {
+			set_pixel(canvas, xm - x, ym + y, color); //   I. Quadrant +x +y
 		}
-		if (arc2::angle_on_arc(arc, vec2::get_angle(arc.C, Vec2{static_cast<double>(xm - y), static_cast<double>(ym - x)}))) {
-			set_pixel(app, pixel_buf, xm - y, ym - x, color); //  II. Quadrant -x +y
+		if (arc2::angle_on_arc(arc, vec2::get_angle(C, Vec2{static_cast<double>(xm - y), static_cast<double>(ym - x)}))) {
+			set_pixel(canvas, xm - y, ym - x, color); //  II. Quadrant -x +y
 		}
-		if (arc2::angle_on_arc(arc, vec2::get_angle(arc.C, Vec2{static_cast<double>(xm + x), static_cast<double>(ym - y)}))) {
-			set_pixel(app, pixel_buf, xm + x, ym - y, color); // III. Quadrant -x -y
+		if (arc2::angle_on_arc(arc, vec2::get_angle(C, Vec2{static_cast<double>(xm + x), static_cast<double>(ym - y)}))) {
+			set_pixel(canvas, xm + x, ym - y, color); // III. Quadrant -x -y
 		}
-		if (arc2::angle_on_arc(arc, vec2::get_angle(arc.C, Vec2{static_cast<double>(xm + y), static_cast<double>(ym + x)}))) {
-			set_pixel(app, pixel_buf, xm + y, ym + x, color); //  IV. Quadrant +x -y
+		if (arc2::angle_on_arc(arc, vec2::get_angle(C, Vec2{static_cast<double>(xm + y), static_cast<double>(ym + x)}))) {
+			set_pixel(canvas, xm + y, ym + x, color); //  IV. Quadrant +x -y
 		}
     r = err;
     if (r <= y)
@@ -61,16 +115,19 @@ void plot_arc(App &app, uint32_t *pixel_buf, const Arc2 &arc, uint32_t color) {
   } while (x < 0);
 }
 
-void plot_circle(App &app, uint32_t *pixel_buf, const Circle2 &circle, uint32_t color) {
-	int xm = std::round(circle.C.x);
-	int ym = std::round(circle.C.y);
-	int r = std::round(circle.radius());
+// bresenham circle in screen space
+void plot_screen_circle(Canvas &canvas, const Vec2 &C, double radius,
+												uint32_t color) {
+	if (!bounds_on_canvas(canvas, C, radius)) { return; }
+	int xm = std::round(C.x);
+	int ym = std::round(C.y);
+	int r = std::round(radius);
   int x = -r, y = 0, err = 2 - 2 * r; /* bottom left to top right */
   do {
-		set_pixel(app, pixel_buf, xm - x, ym + y, color); //   I. Quadrant +x +y
-		set_pixel(app, pixel_buf, xm - y, ym - x, color); //  II. Quadrant -x +y
-		set_pixel(app, pixel_buf, xm + x, ym - y, color); // III. Quadrant -x -y
-		set_pixel(app, pixel_buf, xm + y, ym + x, color); //  IV. Quadrant +x -y
+		set_pixel(canvas, xm - x, ym + y, color); //   I. Quadrant +x +y
+		set_pixel(canvas, xm - y, ym - x, color); //  II. Quadrant -x +y
+		set_pixel(canvas, xm + x, ym - y, color); // III. Quadrant -x -y
+		set_pixel(canvas, xm + y, ym + x, color); //  IV. Quadrant +x -y
     r = err;
     if (r <= y)
       err += ++y * 2 + 1; /* e_xy+e_y < 0 */
@@ -78,78 +135,601 @@ void plot_circle(App &app, uint32_t *pixel_buf, const Circle2 &circle, uint32_t
       err += ++x * 2 + 1; /* -> x-step now */
   } while (x < 0);
 }
-uint32_t get_color(const Shapes& shapes, const Shape &shape) {
-	if (shapes.ref.shape != RefShape::NONE && shape.id == shapes.ref.id) {
-		return special_color;
+
+void plot_circle(Canvas &canvas, const Circle2 &circle, uint32_t color) {
+	if (canvas.mode == RenderMode::ANTIALIASED) {
+		Vec2 C = to_screen(canvas, circle.C);
+		double r = circle.radius() * canvas.scale;
+		if (bounds_on_canvas(canvas, C, r)) {
+			plot_ring_aa(canvas, C, r, nullptr, color);
+		}
+		return;
+	}
+	plot_screen_circle(canvas, to_screen(canvas, circle.C),
+										 circle.radius() * canvas.scale, color);
+}
+
+// dst + (color - dst) * coverage / 255, red and blue share one multiply in
+// their 16 bit lanes, green gets its own
+inline uint32_t blend(uint32_t d, uint32_t color, uint32_t a) {
+	uint32_t ia = 255 - a;
+	uint32_t rb = (color & 0xFF00FF) * a + (d & 0xFF00FF) * ia + 0x800080;
+	uint32_t g = (color & 0x00FF00) * a + (d & 0x00FF00) * ia + 0x008000;
+	// x / 255 rounded per lane, x + x / 256 stays inside the lane
+	rb = ((rb + ((rb >> 8) & 0xFF00FF)) >> 8) & 0xFF00FF;
+	g = ((g + ((g >> 8) & 0x00FF00)) >> 8) & 0x00FF00;
+	return rb | g;
+}
+
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+typedef uint16_t u16x8 __attribute__((vector_size(16)));
+
+// the color split into 16 bit lanes, red and blue, then green next to alpha
+struct BlendColor {
+	u16x8 rb;
+	u16x8 ag;
+};
+
+inline BlendColor blend_color(uint32_t color) {
+	return {reinterpret_cast<u16x8>(u32x4{} + (color & 0xFF00FF)),
+					reinterpret_cast<u16x8>(u32x4{} + ((color >> 8) & 0xFF00FF))};
+}
+
+// same math four pixels at a time with gcc/clang vector extensions, which
+// lower to sse2 on x86 and neon on arm. the lanes are 16 bit so every
+// multiply is one instruction, alpha is dropped like blend does
+inline u32x4 blend4(u32x4 d, u32x4 a32, const BlendColor &color) {
+	u16x8 a = reinterpret_cast<u16x8>(a32 | a32 << 16);
+	u16x8 ia = 255 - a;
+	u16x8 rb = color.rb * a + reinterpret_cast<u16x8>(d & 0xFF00FF) * ia + 0x80;
+	u16x8 ag = color.ag * a + reinterpret_cast<u16x8>((d >> 8) & 0xFF00FF) * ia + 0x80;
+	rb = (rb + (rb >> 8)) >> 8;
+	ag = (ag + (ag >> 8)) >> 8;
+	return reinterpret_cast<u32x4>(rb) |
+				 ((reinterpret_cast<u32x4>(ag) << 8) & 0x00FF00);
+}
+
+// pixels[offsets[i]] gets 255 - coverage[i] and the pixel next further
+// gets coverage[i]. the offsets have to be distinct, four pairs at a time
+// are gathered, blended and written back
+void blend_pairs(uint32_t *pixels, const uint32_t *offsets,
+								 const uint8_t *coverage, int n, int next, uint32_t color) {
+	const BlendColor c = blend_color(color);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		if (i + 16 < n) {
+			__builtin_prefetch(pixels + offsets[i + 16], 1);
+			__builtin_prefetch(pixels + offsets[i + 16] + next, 1);
+		}
+		u32x4 a = {coverage[i], coverage[i + 1], coverage[i + 2], coverage[i + 3]};
+		uint32_t o = offsets[i];
+		if (offsets[i + 1] == o + 1 && offsets[i + 2] == o + 2 &&
+				offsets[i + 3] == o + 3) {
+			// four samples on one row of a shallow run, both rows are contiguous
+			uint32_t *p = pixels + o;
+			u32x4 first, second;
+			std::memcpy(&first, p, sizeof(first));
+			std::memcpy(&second, p + next, sizeof(second));
+			first = blend4(first, 255 - a, c);
+			second = blend4(second, a, c);
+			std::memcpy(p, &first, sizeof(first));
+			std::memcpy(p + next, &second, sizeof(second));
+			continue;
+		}
+		uint32_t *p[4] = {pixels + offsets[i], pixels + offsets[i + 1],
+											pixels + offsets[i + 2], pixels + offsets[i + 3]};
+		u32x4 first = blend4(u32x4{*p[0], *p[1], *p[2], *p[3]}, 255 - a, c);
+		u32x4 second = blend4(u32x4{p[0][next], p[1][next], p[2][next], p[3][next]},
+													a, c);
+		for (int k = 0; k < 4; k++) {
+			p[k][0] = first[k];
+			p[k][next] = second[k];
+		}
+	}
+	for (; i < n; i++) {
+		uint32_t *p = pixels + offsets[i];
+		p[0] = blend(p[0], color, 255 - coverage[i]);
+		p[next] = blend(p[next], color, coverage[i]);
+	}
+}
+
+inline void blend_pixel(Canvas &canvas, int x, int y, uint8_t a, uint32_t color) {
+	if (a && x >= 0 && y >= 0 && x < canvas.width && y < canvas.height) {
+		uint32_t &d = canvas.pixels[x + y * canvas.width];
+		d = blend(d, color, a);
+	}
+}
+
+template <typename T>
+T *scratch(size_t n) {
+	thread_local std::vector<T> buf;
+	if (buf.size() < n) {
+		buf.resize(n);
+	}
+	return buf.data();
+}
+
+uint8_t to_coverage(double c) {
+	return static_cast<uint8_t>(c * 255.0 + 0.5);
+}
+
+// std::floor is a libm call without sse4.1
+inline int floor_int(double v) {
+	int i = static_cast<int>(v);
+	return i - (v < i);
+}
+
+bool on_arc(const Arc2 *arc, const Vec2 &C, double x, double y) {
+	return !arc || arc2::angle_on_arc(*arc, vec2::get_angle(C, Vec2{x, y}));
+}
+
+// wu pairs along the major axis, the pair of a sample is the pixel minor
+// and the one after it on the minor axis. pairs on the canvas are queued
+// for blend_pairs, the few that are cut by an edge are blended right away
+struct WuPairs {
+	Canvas &canvas;
+	bool steep;
+	uint32_t color;
+	int major_stride;
+	int minor_stride;
+	int minor_size;
+	uint32_t *offsets;
+	uint8_t *coverage;
+	int n = 0;
+	WuPairs(Canvas &canvas, bool steep, uint32_t color, int max_pairs)
+		: canvas{canvas}, steep{steep}, color{color},
+			major_stride{steep ? canvas.width : 1},
+			minor_stride{steep ? 1 : canvas.width},
+			minor_size{steep ? canvas.width : canvas.height},
+			offsets{scratch<uint32_t>(max_pairs)},
+			coverage{scratch<uint8_t>(max_pairs)} {}
+
+	void add(int major, int minor, uint8_t c) {
+		if (static_cast<unsigned>(minor) < static_cast<unsigned>(minor_size - 1)) {
+			offsets[n] = static_cast<uint32_t>(major * major_stride + minor * minor_stride);
+			coverage[n] = c;
+			n++;
+			return;
+		}
+		int x = steep ? minor : major;
+		int y = steep ? major : minor;
+		blend_pixel(canvas, x, y, 255 - c, color);
+		blend_pixel(canvas, steep ? x + 1 : x, steep ? y : y + 1, c, color);
+	}
+	void flush() {
+		blend_pairs(canvas.pixels, offsets, coverage, n, minor_stride, color);
+		n = 0;
+	}
+};
+
+// sample i at first + i on the major axis crosses the minor axis at
+// minors[i], samples off an arc are masked when there is a mask
+void wu_samples(Canvas &canvas, bool steep, int first, int n,
+								const double *minors, const uint8_t *mask, uint32_t color) {
+	WuPairs pairs{canvas, steep, color, n};
+	for (int i = 0; i < n; i++) {
+		if (!mask || mask[i]) {
+			int minor = floor_int(minors[i]);
+			pairs.add(first + i, minor, to_coverage(minors[i] - minor));
+		}
+	}
+	pairs.flush();
+}
+
+void plot_line_aa(Canvas &canvas, const Vec2 &A, const Vec2 &B, uint32_t color) {
+	bool steep = std::abs(B.y - A.y) > std::abs(B.x - A.x);
+	// walk along the major axis, a and b are (major, minor) coordinates
+	Vec2 a = steep ? Vec2{A.y, A.x} : A;
+	Vec2 b = steep ? Vec2{B.y, B.x} : B;
+	if (a.x > b.x) { std::swap(a, b); }
+	double gradient = b.x - a.x < gk::epsilon ? 0.0 : (b.y - a.y) / (b.x - a.x);
+	int major_size = steep ? canvas.height : canvas.width;
+	int first = std::max(0, static_cast<int>(std::round(a.x)));
+	int last = std::min(major_size - 1, static_cast<int>(std::round(b.x)));
+	int n = last - first + 1;
+	if (n <= 0) { return; }
+
+	// minor coordinate as 16.16 fixed point dda, the top byte of the
+	// fraction is the coverage of the second pixel. the clipped segment
+	// stays within a pixel of the canvas so the offset keeps it positive
+	constexpr int64_t one = 1 << 16;
+	constexpr int64_t offset = 2;
+	int64_t minor = std::llround((a.y + gradient * (first - a.x) + offset) * one);
+	int64_t step = std::llround(gradient * one);
+
+	WuPairs pairs{canvas, steep, color, n};
+	for (int i = 0; i < n; i++, minor += step) {
+		pairs.add(first + i, static_cast<int>(minor >> 16) - offset,
+							(minor >> 8) & 0xFF);
 	}
+	pairs.flush();
+}
+
+// two opposite quarters of a wu circle sampled along the major axis, they
+// share the square roots. arcs mask samples that are off the arc
+void ring_quarters(Canvas &canvas, bool steep, const Vec2 &C, double r2,
+									 int first, int n, const Arc2 *arc, uint32_t color) {
+	const double c_major = steep ? C.y : C.x;
+	const double c_minor = steep ? C.x : C.y;
+	double *roots = scratch<double>(2 * n);
+	double *minors = roots + n;
+	uint8_t *mask = arc ? scratch<uint8_t>(2 * n) + n : nullptr;
+	for (int i = 0; i < n; i++) {
+		double d = first + i - c_major;
+		roots[i] = std::sqrt(std::max(0.0, r2 - d * d));
+	}
+	for (int sign = -1; sign <= 1; sign += 2) {
+		for (int i = 0; i < n; i++) {
+			minors[i] = c_minor + sign * roots[i];
+		}
+		for (int i = 0; mask && i < n; i++) {
+			mask[i] = steep ? on_arc(arc, C, minors[i], first + i) :
+												on_arc(arc, C, first + i, minors[i]);
+		}
+		wu_samples(canvas, steep, first, n, minors, mask, color);
+	}
+}
+
+// wu circle, the top and bottom caps are sampled per column, the left and
+// right sides per row
+void plot_ring_aa(Canvas &canvas, const Vec2 &C, double radius,
+									const Arc2 *arc, uint32_t color) {
+	const double half = radius / std::numbers::sqrt2;
+	const double r2 = radius * radius;
+
+	// caps, |dx| <= r / sqrt(2)
+	int first = std::max(0, static_cast<int>(std::ceil(C.x - half)));
+	int last = std::min(canvas.width - 1, static_cast<int>(std::floor(C.x + half)));
+	if (last >= first) {
+		ring_quarters(canvas, false, C, r2, first, last - first + 1, arc, color);
+	}
+
+	// sides, |dy| < r / sqrt(2)
+	first = std::max(0, static_cast<int>(std::floor(C.y - half)) + 1);
+	last = std::min(canvas.height - 1, static_cast<int>(std::ceil(C.y + half)) - 1);
+	if (last >= first) {
+		ring_quarters(canvas, true, C, r2, first, last - first + 1, arc, color);
+	}
+}
+
+// markers are drawn thousands of times per frame with a few radii, so they
+// are rasterized once and then copied row by row
+void plot_marker(Canvas &canvas, const Vec2 &P, double radius, uint32_t color) {
+	thread_local StampCache cache;
+	Vec2 C = to_screen(canvas, P);
+	int r = std::round(radius);
+	if (!bounds_on_canvas(canvas, C, r)) { return; }
+	blit_stamp(canvas, get_stamp(cache, r, color), std::round(C.x), std::round(C.y));
+}
+
+const Stamp &get_stamp(StampCache &cache, int radius, uint32_t color) {
+	uint64_t key = (static_cast<uint64_t>(radius) << 32) | color;
+	auto iter = cache.stamps.find(key);
+	if (iter != cache.stamps.end()) {
+		return iter->second;
+	}
+	// rasterize into a square bitmap, then keep only the covered runs
+	int size = 2 * radius + 1;
+	std::vector<uint32_t> bitmap(size * size, bg_color);
+	std::vector<bool> covered(size * size, false);
+	Canvas canvas{bitmap.data(), size, size};
+	plot_screen_circle(canvas, Vec2{static_cast<double>(radius),
+										 static_cast<double>(radius)}, radius, color);
+	for (int i = 0; i < size * size; i++) {
+		covered[i] = bitmap[i] == color;
+	}
+
+	Stamp stamp;
+	stamp.radius = radius;
+	for (int y = 0; y < size; y++) {
+		int x = 0;
+		while (x < size) {
+			if (!covered[x + y * size]) { x++; continue; }
+			int x0 = x;
+			while (x < size && covered[x + y * size]) { x++; }
+			stamp.spans.push_back(StampSpan{y - radius, x0 - radius, x - x0,
+																			stamp.pixels.size()});
+			stamp.pixels.insert(stamp.pixels.end(), bitmap.begin() + x0 + y * size,
+													bitmap.begin() + x + y * size);
+		}
+	}
+	return cache.stamps.emplace(key, std::move(stamp)).first->second;
+}
+
+void blit_stamp(Canvas &canvas, const Stamp &stamp, int x, int y) {
+	for (const auto &span : stamp.spans) {
+		int row = y + span.dy;
+		if (row < 0 || row >= canvas.height) { continue; }
+		int x0 = x + span.dx;
+		int x1 = x0 + span.length;
+		int skip = std::max(0, -x0);
+		x0 = std::max(x0, 0);
+		x1 = std::min(x1, canvas.width);
+		if (x1 > x0) {
+			std::copy_n(stamp.pixels.begin() + span.offset + skip, x1 - x0,
+									canvas.pixels + x0 + row * canvas.width);
+		}
+	}
+}
+
+void fill_rect(Canvas &canvas, int x, int y, int w, int h, uint32_t color) {
+	int x0 = std::max(x, 0), x1 = std::min(x + w, canvas.width);
+	int y0 = std::max(y, 0), y1 = std::min(y + h, canvas.height);
+	for (int row = y0; row < y1; row++) {
+		if (x1 > x0) {
+			std::fill_n(canvas.pixels + x0 + row * canvas.width, x1 - x0, color);
+		}
+	}
+}
+
+// one bar per stage, avg as filled bar and p99 as tick, the white line
+// marks the 60 fps budget
+void plot_profile_overlay(Canvas &canvas, const Profiler &profiler) {
+	constexpr double budget_ms = 1000.0 / 60.0;
+	constexpr double px_per_ms = 200.0 / budget_ms;
+	constexpr int bar_h = 6, gap = 3, x0 = 10, y0 = 10;
+	constexpr uint32_t stage_colors[frame_stage_count] = {
+		cyan, green, red, yellow, magenta, blue, light_grey, white,
+	};
+	int panel_h = frame_stage_count * (bar_h + gap) + gap;
+	fill_rect(canvas, x0 - gap, y0 - gap, 2 * 200 + 2 * gap, panel_h, dark_grey);
+	for (size_t i = 0; i < frame_stage_count; i++) {
+		StageStats s = profile::stats(profiler, static_cast<FrameStage>(i));
+		int y = y0 + i * (bar_h + gap);
+		int avg_w = std::min(400, static_cast<int>(s.avg_ms * px_per_ms) + 1);
+		int p99_x = std::min(400, static_cast<int>(s.p99_ms * px_per_ms));
+		fill_rect(canvas, x0, y, avg_w, bar_h, stage_colors[i]);
+		fill_rect(canvas, x0 + p99_x, y - 1, 2, bar_h + 2, white);
+	}
+	fill_rect(canvas, x0 + 200, y0 - gap, 1, panel_h, white);
+}
+} // namespace detail
+
+using namespace detail;
+
+uint32_t detail::flag_color(const TemporaryFlags &tflags, const size_t index,
+													const bool concealed) {
 	// return color hirachical
-	if (shape.tflags.selected) {
-		return select_color; 
-	} else if (shape.tflags.hl_primary) {
+	if (tflags.selected.test(index)) {
+		return select_color;
+	} else if (tflags.hl_primary.test(index)) {
 		return hl_primary_color;
-	} else if (shape.tflags.hl_secondary) {
+	} else if (tflags.hl_secondary.test(index)) {
 		return hl_secondary_color;
-	} else if (shape.tflags.hl_tertiary) {
+	} else if (tflags.hl_tertiary.test(index)) {
 		return hl_tertiary_color;
-	} else if (shape.pflags.concealed) {
+	} else if (concealed) {
 		return conceal_color;
 	} else {
 		return fg_color;
 	}
 }
-void plot_shapes(App &app, Shapes &shapes) {
-	auto t1 = std::chrono::high_resolution_clock::now();
-	void *pixels;
-	int pitch;
-  if (SDL_LockTexture(app.video.window_texture, NULL, &pixels, &pitch)) {
-		uint32_t *pixels_locked = (uint32_t *)pixels;
-		std::fill_n((uint32_t*)pixels, app.video.w_pixels * app.video.h_pixels, bg_color);
 
-		// [draw all finished shapes]
-		for (const auto &line: shapes.lines) {
-			plot_line(app, pixels_locked, line.geom, get_color(shapes, line));
+uint32_t get_color(const Shapes& shapes, const Shape &shape) {
+	if (shapes.ref.shape != RefShape::NONE && shape.id == shapes.ref.id) {
+		return special_color;
+	}
+	// shapes in construction have no id and no flags yet
+	if (shape.id < 0) {
+		return shape.pflags.concealed ? conceal_color : fg_color;
+	}
+	return flag_color(shapes.shape_tflags, shape.id, shape.pflags.concealed);
+}
+
+void detail::plot_entries(Canvas &canvas, const Shapes &shapes,
+													const std::pmr::vector<GridEntry> &entries,
+													const Box &view, const int layer) {
+	double min_extent = lod_min_extent_px / canvas.scale;
+	auto skip = [&](const Shape &shape) {
+		if (layer >= 0) {
+			return shape.pflags.layer != layer;
 		}
-		for (const auto &circle: shapes.circles) {
-			plot_circle(app, pixels_locked, circle.geom, get_color(shapes, circle));
+		return !layers::visible(shapes.layers, shape.pflags.layer) ||
+					 layers::frozen(shapes.layers, shape.pflags.layer);
+	};
+	// a frozen layer is locked, it shows no selection or highlights
+	auto color = [&](const Shape &shape) {
+		if (layer >= 0) {
+			return shape.pflags.concealed ? conceal_color : fg_color;
 		}
-		for (const auto &arc: shapes.arcs) {
-			plot_arc(app, pixels_locked, arc.geom, get_color(shapes, arc));
+		return get_color(shapes, shape);
+	};
+	for (auto [type, index] : entries) {
+		if (type == ShapeType::LINE && index < shapes.lines.size()) {
+			const Line &line = shapes.lines[index];
+			if (!skip(line) && spatial::overlap(spatial::bounds(line.geom), view) &&
+					line.geom.length() >= min_extent) {
+				plot_line(canvas, line.geom, color(line));
+			}
+		} else if (type == ShapeType::CIRCLE && index < shapes.circles.size()) {
+			const Circle &circle = shapes.circles[index];
+			double r = circle.geom.radius();
+			if (!skip(circle) && r >= min_extent &&
+					spatial::ring_overlap(view, circle.geom.C, r)) {
+				plot_circle(canvas, circle.geom, color(circle));
+			}
+		} else if (type == ShapeType::ARC && index < shapes.arcs.size()) {
+			const Arc &arc = shapes.arcs[index];
+			double r = arc.geom.radius();
+			if (!skip(arc) && r >= min_extent &&
+					spatial::ring_overlap(view, arc.geom.C, r)) {
+				plot_arc(canvas, arc.geom, color(arc));
+			}
 		}
+	}
+}
 
-		// draw circle around snap point
-		if (shapes.snap.shape != SnapShape::NONE) {
-			plot_circle(app, pixels_locked, Circle2{shapes.snap.point, shapes.snap.distance}, fg_color);
+LayerRaster &detail::layer_raster(const size_t layer) {
+	thread_local std::array<LayerRaster, Layers::max_layers> rasters;
+	return rasters[layer];
+}
+
+void detail::composite_layer(Canvas &canvas, const Shapes &shapes,
+														 const std::pmr::vector<GridEntry> &entries,
+														 const Box &view, const uint8_t layer) {
+	LayerRaster &raster = layer_raster(layer);
+	uint64_t revision = shapes.layers.layers[layer].revision;
+	if (!raster.valid || raster.width != canvas.width ||
+			raster.height != canvas.height || raster.origin.x != canvas.origin.x ||
+			raster.origin.y != canvas.origin.y || raster.scale != canvas.scale ||
+			raster.mode != canvas.mode || raster.revision != revision) {
+		raster.pixels.assign(static_cast<size_t>(canvas.width) * canvas.height,
+												 bg_color);
+		raster.width = canvas.width;
+		raster.height = canvas.height;
+		raster.origin = canvas.origin;
+		raster.scale = canvas.scale;
+		raster.mode = canvas.mode;
+		raster.revision = revision;
+		raster.valid = true;
+		Canvas layer_canvas{raster.pixels.data(), raster.width, raster.height,
+			raster.origin, raster.scale, raster.mode};
+		plot_entries(layer_canvas, shapes, entries, view, layer);
+	}
+	const size_t n = raster.pixels.size();
+	for (size_t i = 0; i < n; i++) {
+		if (raster.pixels[i] != bg_color) {
+			canvas.pixels[i] = raster.pixels[i];
 		}
+	}
+}
 
-		// draw circle around hl_secondary ixn_points
-		for (const auto &ixn_point : shapes.ixn_points) {
-			if (ixn_point.tflags.hl_secondary) {
-				plot_circle(app, pixels_locked, Circle2{ixn_point.P, shapes.snap.distance},
-										get_color(shapes, ixn_point));
+void detail::plot_gen_preview(Canvas &canvas, const GenShapes &gen_shapes) {
+	double half = gen_tick_px / canvas.scale;
+	auto plot_ticks = [&](const GenPreview &preview) {
+		for (const RelationTick &tick : preview.ticks) {
+			plot_line(canvas, Line2{tick.P - tick.normal * half,
+															tick.P + tick.normal * half},
+								hl_tertiary_color);
+		}
+	};
+	for (const GenLine &gen_line : gen_shapes.lines) {
+		plot_ticks(gen_line.preview);
+	}
+	for (const GenCircle &gen_circle : gen_shapes.circles) {
+		plot_ticks(gen_circle.preview);
+	}
+	for (const GenArc &gen_arc : gen_shapes.arcs) {
+		plot_ticks(gen_arc.preview);
+	}
+}
+
+void render_scene(Canvas &canvas, const Shapes &shapes) {
+	// only what the spatial index reports inside the view is drawn, so the
+	// cost follows the visible part of the scene
+	double marker_margin = shapes.snap.distance / canvas.scale;
+	Box view{canvas.origin, canvas.origin +
+		Vec2{static_cast<double>(canvas.width), static_cast<double>(canvas.height)} *
+		(1.0 / canvas.scale)};
+	Box query_box{view.min - Vec2{marker_margin, marker_margin},
+								view.max + Vec2{marker_margin, marker_margin}};
+	std::pmr::vector<GridEntry> visible{arena::frame()};
+	if (shapes.grid.built) {
+		spatial::query(shapes.grid, query_box, visible);
+	} else {
+		spatial::collect_all(shapes, visible);
+	}
+	double min_extent = lod_min_extent_px / canvas.scale;
+
+	// [draw all finished shapes] frozen layers below the live ones
+	const std::vector<Layer> &ls = shapes.layers.layers;
+	for (size_t l = 0; l < ls.size(); l++) {
+		if (ls[l].frozen && ls[l].visible) {
+			composite_layer(canvas, shapes, visible, view, static_cast<uint8_t>(l));
+		}
+	}
+	plot_entries(canvas, shapes, visible, view, -1);
+
+	// instance copies are not in the grid and take the color of their base
+	if (!shapes.instance_groups.empty()) {
+		std::pmr::vector<Instance> copies{arena::frame()};
+		instances::expand(shapes, copies);
+		for (const Instance &copy : copies) {
+			if (!layers::visible(shapes.layers, copy.layer) ||
+					!spatial::overlap(instances::bounds(copy), view)) {
+				continue;
+			}
+			Shape base{copy.base_id};
+			base.pflags.concealed = copy.concealed;
+			uint32_t color = get_color(shapes, base);
+			if (copy.type == ShapeType::LINE && copy.line.length() >= min_extent) {
+				plot_line(canvas, copy.line, color);
+			} else if (copy.type == ShapeType::CIRCLE &&
+								 copy.circle.radius() >= min_extent &&
+								 spatial::ring_overlap(view, copy.circle.C, copy.circle.radius())) {
+				plot_circle(canvas, copy.circle, color);
+			} else if (copy.type == ShapeType::ARC && copy.arc.radius() >= min_extent &&
+								 spatial::ring_overlap(view, copy.arc.C, copy.arc.radius())) {
+				plot_arc(canvas, copy.arc, color);
 			}
 		}
+	}
 
+	// node markers would cover the drawing when zoomed out
+	if (canvas.scale < lod_node_min_scale) {
+		return;
+	}
+	for (auto [type, index] : visible) {
+		// draw circle around hl_secondary ixn_points
+		if (type == ShapeType::IXN_POINT && index < shapes.ixn_points.size()) {
+			const Node &ixn_point = shapes.ixn_points[index];
+			if (shapes.ixn_tflags.hl_secondary.test(index)) {
+				plot_marker(canvas, ixn_point.P, shapes.snap.distance,
+										flag_color(shapes.ixn_tflags, index,
+															 ixn_point.pflags.concealed));
+			}
 		// draw circle around  def_points
-		for (const auto &def_point : shapes.def_points) {
-			plot_circle(app, pixels_locked, Circle2{def_point.P, shapes.snap.distance/3.0},
-									get_color(shapes, def_point));
+		} else if (type == ShapeType::DEF_POINT && index < shapes.def_points.size()) {
+			const Node &def_point = shapes.def_points[index];
+			if (def_point.pflags.concealed && !shapes.def_tflags.highlighted(index)) {
+				continue;
+			}
+			plot_marker(canvas, def_point.P, shapes.snap.distance/3.0,
+									flag_color(shapes.def_tflags, index,
+														 def_point.pflags.concealed));
+		}
+	}
+}
+
+void plot_shapes(App &app, Shapes &shapes, const GenShapes &gen_shapes) {
+	profile::begin(app.profiler, FrameStage::RASTER);
+	void *pixels;
+	int pitch;
+  if (SDL_LockTexture(app.video.window_texture, NULL, &pixels, &pitch)) {
+		// shapes were added or removed this frame, indices in the grid moved
+		if (shapes.quantity_change || !shapes.grid.built) {
+			spatial::rebuild(shapes.grid, shapes);
+		}
+		Canvas canvas{(uint32_t *)pixels, app.video.w_pixels, app.video.h_pixels,
+			app.camera.origin, app.camera.zoom, app.video.render_mode};
+		std::fill_n(canvas.pixels, canvas.width * canvas.height, bg_color);
+
+		render_scene(canvas, shapes);
+
+		if (app.context.mode == AppMode::GEN) {
+			plot_gen_preview(canvas, gen_shapes);
+		}
+
+		// draw circle around snap point
+		if (shapes.snap.shape != SnapShape::NONE) {
+			plot_marker(canvas, shapes.snap.point, shapes.snap.distance, fg_color);
 		}
 
 		// [draw the temporary shape from base to cursor live if in construction]
 		if (shapes.construct.shape == ConstructShape::LINE) {
-			plot_line(app, pixels_locked, shapes.construct.line.geom,
+			plot_line(canvas, shapes.construct.line.geom,
 								get_color(shapes, shapes.construct.line));
 		}
 		if (shapes.construct.shape == ConstructShape::CIRCLE) {
-			plot_circle(app, pixels_locked, shapes.construct.circle.geom,
+			plot_circle(canvas, shapes.construct.circle.geom,
 					get_color(shapes, shapes.construct.circle));
 		}
 		if (shapes.construct.shape == ConstructShape::ARC) {
 			if (shapes.construct.point_set == PointSet::SECOND) {
-				plot_arc(app, pixels_locked, shapes.construct.arc.geom, 
+				plot_arc(canvas, shapes.construct.arc.geom, 
 						get_color(shapes, shapes.construct.arc));
 			} else {
-				plot_line(app, pixels_locked, 
+				plot_line(canvas, 
 									Line2{shapes.construct.arc.geom.C,
 									shapes.construct.arc.geom.S}, 
 									get_color(shapes, shapes.construct.arc));
@@ -158,17 +738,24 @@ void plot_shapes(App &app, Shapes &shapes) {
 
 		// [draw the edit shape from base to cursor live if in construction]
 		if (shapes.edit.shape == EditShape::LINE) {
-			plot_line(app, pixels_locked, shapes.edit.line.geom,
+			plot_line(canvas, shapes.edit.line.geom,
 								get_color(shapes, shapes.construct.line));
 		}
 
+		if (app.profiler.overlay) {
+			plot_profile_overlay(canvas, app.profiler);
+		}
+
 		SDL_UnlockTexture(app.video.window_texture);
 	}
+	profile::end(app.profiler, FrameStage::RASTER);
+
+	profile::begin(app.profiler, FrameStage::RENDER_TEXTURE);
 	SDL_RenderTexture(app.video.renderer, app.video.window_texture, NULL, NULL);
-	auto t2 = std::chrono::high_resolution_clock::now();
-	std::chrono::duration<double, std::milli> 
-		dt_ms = t2 - t1;
-	// std::cout << "dt_out: " << dt_ms << std::endl;
+	profile::end(app.profiler, FrameStage::RENDER_TEXTURE);
+
+	profile::begin(app.profiler, FrameStage::PRESENT);
 	SDL_RenderPresent(app.video.renderer);
+	profile::end(app.profiler, FrameStage::PRESENT);
 }
 } // namespace draw
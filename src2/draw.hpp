@@ -2,8 +2,10 @@
 #pragma once
 #include "core.hpp"
 #include "app.hpp"
+#include "gen.hpp"
 #include "graphics.hpp"
 #include "shapes.hpp"
+#include "spatial.hpp"
 
 namespace draw {
 constexpr uint32_t black =				0x00000000;
@@ -30,12 +32,91 @@ constexpr uint32_t hl_tertiary_color = magenta;
 
 constexpr uint32_t special_color = blue;
 
+// level of detail
+constexpr double lod_node_min_scale = 0.35; // no node markers below
+constexpr double lod_min_extent_px = 1.0; // shapes smaller are skipped
+
+constexpr double gen_tick_px = 6.0; // half length of a relation tick
+} // namespace draw
+
+// pixel buffer the rasterizer writes into, either the locked window texture
+// or a plain buffer for headless export
+// world to screen: pixel = (P - origin) * scale
+struct Canvas {
+	uint32_t *pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	Vec2 origin{};
+	double scale = 1.0;
+	RenderMode mode = RenderMode::ALIASED;
+};
+
+// pre-rasterized marker, spans index into pixels row by row
+struct StampSpan {
+	int dy = 0;
+	int dx = 0;
+	int length = 0;
+	size_t offset = 0;
+};
+struct Stamp {
+	int radius = 0;
+	std::vector<uint32_t> pixels;
+	std::vector<StampSpan> spans;
+};
+// keyed by radius and color
+struct StampCache {
+	std::unordered_map<uint64_t, Stamp> stamps;
+};
+
+// pixels of one frozen layer for one view, bg_color where nothing is drawn
+struct LayerRaster {
+	std::vector<uint32_t> pixels;
+	int width = 0;
+	int height = 0;
+	Vec2 origin{};
+	double scale = 0.0;
+	RenderMode mode = RenderMode::ALIASED;
+	uint64_t revision = 0;
+	bool valid = false;
+};
+
+namespace draw {
 namespace detail {
-void set_pixel(App &app, uint32_t *pixel_buf, int x, int y, uint32_t color);
-void plot_line(App &app, uint32_t *pixel_buf, const Line2 &line, uint32_t color);
-void plot_circle(App &app, uint32_t *pixel_buf, const Circle2 &circle, uint32_t color);
-void plot_arc(App &app, uint32_t *pixel_buf, const Arc2 &arc, uint32_t color);
+Vec2 to_screen(const Canvas &canvas, const Vec2 &P);
+void set_pixel(Canvas &canvas, int x, int y, uint32_t color);
+void plot_line(Canvas &canvas, const Line2 &line, uint32_t color);
+void plot_circle(Canvas &canvas, const Circle2 &circle, uint32_t color);
+void plot_arc(Canvas &canvas, const Arc2 &arc, uint32_t color);
+// antialiased variants take screen coordinates
+void blend_pairs(uint32_t *pixels, const uint32_t *offsets,
+								 const uint8_t *coverage, int n, int next, uint32_t color);
+void plot_line_aa(Canvas &canvas, const Vec2 &A, const Vec2 &B, uint32_t color);
+void plot_ring_aa(Canvas &canvas, const Vec2 &C, double radius,
+									const Arc2 *arc, uint32_t color);
+// circle with a fixed screen radius around a world point
+void plot_marker(Canvas &canvas, const Vec2 &P, double radius, uint32_t color);
+const Stamp &get_stamp(StampCache &cache, int radius, uint32_t color);
+void blit_stamp(Canvas &canvas, const Stamp &stamp, int x, int y);
+void fill_rect(Canvas &canvas, int x, int y, int w, int h, uint32_t color);
+void plot_profile_overlay(Canvas &canvas, const Profiler &profiler);
+uint32_t flag_color(const TemporaryFlags &tflags, const size_t index,
+										const bool concealed);
+// stored shapes among the entries, layer < 0 draws every visible layer
+// that is not frozen, otherwise only that layer without highlights
+void plot_entries(Canvas &canvas, const Shapes &shapes,
+									const std::pmr::vector<GridEntry> &entries, const Box &view,
+									const int layer);
+LayerRaster &layer_raster(const size_t layer);
+// redraws the raster when the view or the layer changed and copies its
+// drawn pixels over the canvas
+void composite_layer(Canvas &canvas, const Shapes &shapes,
+										 const std::pmr::vector<GridEntry> &entries, const Box &view,
+										 const uint8_t layer);
+// ticks of the relation previews of the gen shapes
+void plot_gen_preview(Canvas &canvas, const GenShapes &gen_shapes);
 } // namespace detail
-void plot_shapes(App &app, Shapes &shapes);
-uint32_t get_color(const Shapes &shapes);
+uint32_t get_color(const Shapes &shapes, const Shape &shape);
+// finished shapes and node markers, everything that is part of the drawing
+void render_scene(Canvas &canvas, const Shapes &shapes);
+void plot_shapes(App &app, Shapes &shapes, const GenShapes &gen_shapes);
 } // namespace draw
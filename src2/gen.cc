@@ -1,33 +1,46 @@
 #include "gen.hpp"
+#include "arena.hpp"
+#include "nodes.hpp"
+#include "parallel.hpp"
+#include "relstream.hpp"
+#include <charconv>
 
 namespace gen {
 
 
 void hl_nodes_of_shape(Shapes &shapes, int shape_id) {
-	for (auto &node : shapes.ixn_points) {
+	for (size_t i = 0; i < shapes.ixn_points.size(); i++) {
+		const Node &node = shapes.ixn_points[i];
 		if (!node.pflags.concealed && shapes::id_match(node.ids, shape_id)) {
-			node.tflags.hl_secondary = true;
+			shapes.ixn_tflags.hl_secondary.set(i);
 		}
 	}
-	for (auto &node : shapes.def_points) {
+	for (size_t i = 0; i < shapes.def_points.size(); i++) {
+		const Node &node = shapes.def_points[i];
 		if (!node.pflags.concealed && shapes::id_match(node.ids, shape_id)) {
-			node.tflags.hl_secondary = true;
+			shapes.def_tflags.hl_secondary.set(i);
 		}
 	}
 }
 
 void hl_gen_shapes_and_nodes(Shapes &shapes, GenShapes &gen_shapes) {
-	for (auto &line : gen_shapes.lines) {
-		line.shape.tflags.hl_secondary = true;
-		hl_nodes_of_shape(shapes, line.shape.id);
+	for (auto &gen_line : gen_shapes.lines) {
+		if (Line *line = shapes.get_line_by_id(gen_line.id)) {
+			shapes.shape_tflags.hl_secondary.set(line->id);
+			hl_nodes_of_shape(shapes, line->id);
+		}
 	}
-	for (auto &circle : gen_shapes.circles) {
-		circle.shape.tflags.hl_secondary = true;
-		hl_nodes_of_shape(shapes, circle.shape.id);
+	for (auto &gen_circle : gen_shapes.circles) {
+		if (Circle *circle = shapes.get_circle_by_id(gen_circle.id)) {
+			shapes.shape_tflags.hl_secondary.set(circle->id);
+			hl_nodes_of_shape(shapes, circle->id);
+		}
 	}
-	for (auto &arc : gen_shapes.arcs) {
-		arc.shape.tflags.hl_secondary = true;
-		hl_nodes_of_shape(shapes, arc.shape.id);
+	for (auto &gen_arc : gen_shapes.arcs) {
+		if (Arc *arc = shapes.get_arc_by_id(gen_arc.id)) {
+			shapes.shape_tflags.hl_secondary.set(arc->id);
+			hl_nodes_of_shape(shapes, arc->id);
+		}
 	}
 }
 
@@ -47,23 +60,22 @@ void clear(Shapes &shapes, GenShapes &gen_shapes) {
 	gen_shapes.selection_order.clear();
 }
 
-void set_origin(Shapes &shapes, GenShapes &gen_shapes, Node &node) {
+void set_origin(Shapes &shapes, GenShapes &gen_shapes, ShapeType type,
+								size_t index) {
+	bool is_ixn = type == ShapeType::IXN_POINT;
+	std::vector<Node> &nodes = is_ixn ? shapes.ixn_points : shapes.def_points;
+	TemporaryFlags &node_tflags = is_ixn ? shapes.ixn_tflags : shapes.def_tflags;
 	// point origin to the node
-	gen_shapes.origin = node;
+	gen_shapes.origin = nodes[index];
 	gen_shapes.origin_set = true;
 	// disable snapping to nodes
 	shapes.snap.enabled_for_node_shapes = false;
 	// highlight all shapes that have their id in the origin node
-	for (auto &line : shapes.lines) {
-		line.tflags.hl_primary = shapes::id_match(gen_shapes.origin.ids, line.id);
-	}
-	for (auto &circle : shapes.circles) {
-		circle.tflags.hl_primary = shapes::id_match(gen_shapes.origin.ids, circle.id);
-	}
-	for (auto &arc : shapes.arcs) {
-		arc.tflags.hl_primary = shapes::id_match(gen_shapes.origin.ids, arc.id);
+	shapes.shape_tflags.hl_primary.clear();
+	for (int id : gen_shapes.origin.ids) {
+		shapes.shape_tflags.hl_primary.set(id);
 	}
-	node.tflags.hl_primary = true;
+	node_tflags.hl_primary.set(index);
 }
 
 void maybe_select(Shapes &shapes, GenShapes &gen_shapes) {
@@ -73,36 +85,39 @@ void maybe_select(Shapes &shapes, GenShapes &gen_shapes) {
 		// add shape to a gen_shapes vector and update selection_order 
 		if (shapes::id_match(gen_shapes.origin.ids, shapes.snap.id)) {
 			if (shapes.snap.shape == SnapShape::LINE) {
-				auto &line = shapes.lines[shapes.snap.index];
-				if (detail::shape_is_duplicate(gen_shapes.lines, line)) {
+				const int id = shapes.snap.id;
+				if (!shapes.lines.contains(shapes.snap.handle) ||
+						detail::shape_is_duplicate(gen_shapes.lines, id)) {
 					// do nothing
 				} else {
 					gen_shapes.lines.push_back(
-						GenLine{line, gen_shapes.origin.P, shapes.snap.point});
+						GenLine{id, gen_shapes.origin.P, shapes.snap.point});
 					gen_shapes.selection_order.emplace_back(
 							ShapeType::LINE, gen_shapes.lines.size() - 1);
 					reset(shapes, gen_shapes);
 					cout << "gen_line added" << endl;
 				}
 			} else if (shapes.snap.shape == SnapShape::CIRCLE) {
-				auto &circle = shapes.circles[shapes.snap.index];
-				if (detail::shape_is_duplicate(gen_shapes.circles, circle)) {
+				const int id = shapes.snap.id;
+				if (!shapes.circles.contains(shapes.snap.handle) ||
+						detail::shape_is_duplicate(gen_shapes.circles, id)) {
 					// do nothing
 				} else {
 					gen_shapes.circles.push_back(
-						GenCircle{circle, gen_shapes.origin.P, shapes.snap.point});
+						GenCircle{id, gen_shapes.origin.P, shapes.snap.point});
 					gen_shapes.selection_order.emplace_back(
 							ShapeType::CIRCLE, gen_shapes.circles.size() - 1);
 					reset(shapes, gen_shapes);
 					cout << "gen_circle added" << endl;
 				}
 			} else if (shapes.snap.shape == SnapShape::ARC) {
-				auto &arc = shapes.arcs[shapes.snap.index];
-				if (detail::shape_is_duplicate(gen_shapes.arcs, arc)) {
+				const int id = shapes.snap.id;
+				if (!shapes.arcs.contains(shapes.snap.handle) ||
+						detail::shape_is_duplicate(gen_shapes.arcs, id)) {
 					// do nothing
 				} else {
 					gen_shapes.arcs.push_back(
-						GenArc{arc, gen_shapes.origin.P, shapes.snap.point});
+						GenArc{id, gen_shapes.origin.P, shapes.snap.point});
 					gen_shapes.selection_order.emplace_back(
 							ShapeType::ARC, gen_shapes.arcs.size() - 1);
 					reset(shapes, gen_shapes);
@@ -112,274 +127,679 @@ void maybe_select(Shapes &shapes, GenShapes &gen_shapes) {
 		}
 	} else {
 		if (shapes.snap.shape == SnapShape::IXN_POINT) {
-			set_origin(shapes, gen_shapes, shapes.ixn_points[shapes.snap.index]);
+			set_origin(shapes, gen_shapes, ShapeType::IXN_POINT, shapes.snap.index);
 		} else if (shapes.snap.shape == SnapShape::DEF_POINT) {
-			set_origin(shapes, gen_shapes, shapes.def_points[shapes.snap.index]);
+			set_origin(shapes, gen_shapes, ShapeType::DEF_POINT, shapes.snap.index);
 		}
 	}
 }
 
-vector<double> line_relations(Shapes &shapes, GenLine &gen_line) {
-	auto &line = gen_line.shape;
-
-	vector<double> distances {};
-	vector<double> distance_relations {};
-
-	Vec2 A = gen_line.start_point;
-	Vec2 B {};
-	if (A.x == line.geom.A.x && A.y == line.geom.A.y) {
-		B = line.geom.B;
-	} else {
-		B = line.geom.A;
+namespace detail {
+void incident_points(const Shapes &shapes, const int id,
+										 std::pmr::vector<Vec2> &out) {
+	const NodeIndex &index = shapes.node_index;
+	if (id < 0 || static_cast<size_t>(id) >= index.ixn.size()) {
+		return;
 	}
-
-	double max_distance = (vec2::distance(A, B));
-
-	// add distances between start_point and ixn_points to distances
-	for (auto &ixn_point : shapes.ixn_points) {
-		if (!ixn_point.pflags.concealed && std::any_of(ixn_point.ids.begin(), ixn_point.ids.end(),
-										[&](const auto &id) { return id == line.id; })) {
-			distances.push_back(vec2::distance(A, ixn_point.P));
+	for (uint32_t k : index.ixn[id]) {
+		const Node &node = shapes.ixn_points[k];
+		if (!node.pflags.concealed) {
+			out.push_back(node.P);
 		}
 	}
+}
+
+bool line_from_a(const Line2 &line, const Vec2 &A) {
+	Vec2 d = A - line.A;
+	return vec2::dot(d, d) <= gk::epsilon * gk::epsilon;
+}
 
-	// add 0.0 to distances if not allready inside 
-	auto iter = find_if(distances.begin(), distances.end(),
-			[](double distance){ return fabs(distance) < gk::epsilon; });
-	if (iter == distances.end()) {
-		distances.push_back(0.0);
+// in units of t, distances are compared squared against the tolerance
+void line_kernel(const Shapes &shapes, const int id, const Line2 &line,
+								 const Vec2 &A, std::pmr::vector<double> &out) {
+	const std::vector<NodeParam> &params = nodes::params(shapes, id);
+	const Vec2 d = line.B - line.A;
+	const double length2 = vec2::dot(d, d);
+	if (length2 == 0.0) {
+		return;
 	}
-	// remove max_distance from distances if not allready inside
-	iter = find_if(distances.begin(), distances.end(),
-			[=](double d){ return fabs(d - max_distance) < gk::epsilon; });
-	if (iter != distances.end()) {
-		distances.erase(iter);
+	const double tolerance2 = gk::epsilon * gk::epsilon / length2;
+	const double start = vec2::dot(A - line.A, d) / length2;
+	const double end = line_from_a(line, A) ? 1.0 : 0.0;
+	const double max_distance = std::abs(end - start);
+	if (max_distance * max_distance <= tolerance2) {
+		return;
 	}
 
-	// sort distances ascending
-	sort(distances.begin(), distances.end(),
-			 [](double v1, double v2) { return v1 < v2; });
-
-	// normalize
-	for (auto &distance : distances) {
-		distance /= max_distance;
+	size_t begin = out.size();
+	bool end_seen = false;
+	auto push = [&](const NodeParam &param) {
+		if (shapes.ixn_points[param.node].pflags.concealed) {
+			return;
+		}
+		double distance = std::abs(param.value - start);
+		double to_end = param.value - end;
+		if (distance * distance <= tolerance2) {
+			out.push_back(0.0);
+		} else if (!end_seen && to_end * to_end <= tolerance2) {
+			end_seen = true;
+		} else {
+			out.push_back(distance / max_distance);
+		}
+	};
+	// outwards from the start, the closer side first
+	auto ahead = std::lower_bound(params.begin(), params.end(), start,
+		[](const NodeParam &param, const double t) { return param.value < t; });
+	auto behind = std::make_reverse_iterator(ahead);
+	while (ahead != params.end() || behind != params.rend()) {
+		if (behind == params.rend() ||
+				(ahead != params.end() && ahead->value - start <= start - behind->value)) {
+			push(*ahead++);
+		} else {
+			push(*behind++);
+		}
+	}
+	if (out.size() == begin || out[begin] != 0.0) {
+		out.insert(out.begin() + begin, 0.0);
 	}
 
 #ifdef debug
 	// info print
 	cout << "distances: ";
-	for (double distance : distances) {
-			std::cout << distance << " ";
+	for (auto iter = out.begin() + begin; iter != out.end(); iter++) {
+			std::cout << *iter << " ";
 	}
 	std::cout << std::endl;
-	cout << "max distance: " << max_distance << endl;
 	cout << "start point: " << A.x << "," << A.y << endl;
-	cout << "end point: " << B.x << "," << B.y << endl;
+	cout << "from A: " << line_from_a(line, A) << endl;
 #endif
+}
 
-	return distances;
+// start rotated onto the x axis and y towards the direction of travel,
+// the angle of travel of v is the polar angle of the result
+Vec2 to_travel_frame(const Vec2 &s, const Vec2 &v, const bool clockwise) {
+	double cross = s.x * v.y - s.y * v.x;
+	// angles of get_angle_of_point grow against the cross product
+	return Vec2{vec2::dot(s, v), clockwise ? cross : -cross};
 }
 
-// TODO: function should take some point on the circle as arg
-vector<double> circle_relations(Shapes &shapes, GenCircle &gen_circle) {
-	auto &circle = gen_circle.shape;
-	vector<double> angles {};
-
-	// put all angles of ixn_points into angles vector
-	for (auto &ixn_point : shapes.ixn_points) {
-		if (!ixn_point.pflags.concealed && std::any_of(ixn_point.ids.begin(), ixn_point.ids.end(),
-										[&](const auto &id) { return id == circle.id; })) {
-			angles.push_back(circle2::get_angle_of_point(circle.geom, ixn_point.P));
-		}
-	}
-
-	// determine direction
-	bool direction_clockwise = false;
-	double start_angle = circle2::get_angle_of_point(circle.geom, gen_circle.start_point);
-	double dir_angle = circle2::get_angle_of_point(circle.geom, gen_circle.dir_point);
-	double start_angle_opposite {};
-	if (start_angle > numbers::pi) {
-		start_angle_opposite = start_angle - numbers::pi;
-		if (dir_angle >= start_angle || dir_angle < start_angle_opposite) {
-			direction_clockwise = false;
-		} else {
-			direction_clockwise = true;
-		}
+double travel_angle(const Vec2 &v) {
+	double angle = std::atan2(v.y, v.x);
+	return angle < 0.0 ? angle + 2.0 * numbers::pi : angle;
+}
+
+double arc_sweep(const Arc2 &arc) {
+	double sweep = travel_angle(to_travel_frame(arc.S - arc.C, arc.E - arc.C,
+																							arc.clockwise));
+	return sweep < gk::epsilon ? 2.0 * numbers::pi : sweep;
+}
+
+bool circle_clockwise(const Circle2 &circle, const Vec2 &start,
+											const Vec2 &dir) {
+	Vec2 d = to_travel_frame(start - circle.C, dir - circle.C, false);
+	return !(d.y > 0.0 || (d.y == 0.0 && d.x > 0.0));
+}
+
+void angular_kernel(const Shapes &shapes, const int id, const Vec2 &C,
+										const Vec2 &start, const bool clockwise, const Arc2 *arc,
+										std::pmr::vector<double> &out) {
+	const double turn = 2.0 * numbers::pi;
+	const std::vector<NodeParam> &params = nodes::params(shapes, id);
+	const size_t n = params.size();
+	const double start_angle = circle2::get_angle_of_point(Circle2{C, start}, start);
+	auto travel = [&](const double angle) {
+		double v = clockwise ? start_angle - angle : angle - start_angle;
+		return v < 0.0 ? v + turn : v;
+	};
+	// i-th node in the direction of travel, from the first one at or after
+	// the start, params ascend against the clockwise direction
+	size_t first = 0;
+	if (clockwise) {
+		auto iter = std::upper_bound(params.begin(), params.end(), start_angle,
+			[](const double angle, const NodeParam &param) { return angle < param.value; });
+		first = iter == params.begin() ? n - 1 : iter - params.begin() - 1;
 	} else {
-		start_angle_opposite = start_angle + numbers::pi;
-		if (dir_angle >= start_angle && dir_angle < start_angle_opposite) {
-			direction_clockwise = false;
-		} else {
-			direction_clockwise = true;
+		auto iter = std::lower_bound(params.begin(), params.end(), start_angle,
+			[](const NodeParam &param, const double angle) { return param.value < angle; });
+		first = iter == params.end() ? 0 : iter - params.begin();
+	}
+	auto at = [&](const size_t i) -> const NodeParam & {
+		return params[clockwise ? (first + n - i) % n : (first + i) % n];
+	};
+	auto visible = [&](const NodeParam &param) {
+		return !shapes.ixn_points[param.node].pflags.concealed;
+	};
+
+	double sweep = turn;
+	double end_travel = turn;
+	if (arc) {
+		sweep = arc_sweep(*arc);
+		// nodes behind the start are not reached in this direction
+		const Vec2 &end = clockwise == arc->clockwise ? arc->E : arc->S;
+		end_travel = travel(circle2::get_angle_of_point(arc->to_circle(), end));
+		if (end_travel > turn - gk::epsilon) {
+			end_travel = 0.0;
 		}
 	}
 
-	// apply offset rotation so that start_angle is 0.0
-	for (auto &angle : angles) {
-		double new_angle = angle - start_angle;
-		if (abs(new_angle) > gk::epsilon) {
-			if (new_angle < 0.0) {
-				angle = 2 * numbers::pi + new_angle;
-			} else {
-				angle = new_angle;
-			}
-		} else {
-			angle = 0.0;
+	// the last nodes in travel order that are within epsilon behind the
+	// start are at 0 and go first
+	size_t begin = out.size();
+	size_t wrapped = 0;
+	while (wrapped < n && travel(at(n - 1 - wrapped).value) > turn - gk::epsilon) {
+		wrapped++;
+	}
+	for (size_t i = n - wrapped; i < n; i++) {
+		if (visible(at(i))) {
+			out.push_back(0.0);
 		}
 	}
-
-	// flip angle values if clockwise
-	if (direction_clockwise) {
-		for (auto &angle : angles) {
-			if (angle != 0.0) {
-				angle = 2 * numbers::pi - angle;
-			}
+	for (size_t i = 0; i < n - wrapped; i++) {
+		const NodeParam &param = at(i);
+		double angle = travel(param.value);
+		if (angle > end_travel + gk::epsilon) {
+			break;
+		}
+		if (visible(param)) {
+			out.push_back(angle <= gk::epsilon ? 0.0 : angle);
 		}
 	}
 
-	// sort the vector of angle values 
-	sort(angles.begin(), angles.end(),
-			 [](double a1, double a2) { return a1 < a2; });
+	if (arc) {
+		// like the end of a line, the start counts and the far end does not
+		if (out.size() == begin || out[begin] != 0.0) {
+			out.insert(out.begin() + begin, 0.0);
+		}
+		if (out.size() > begin && std::abs(out.back() - sweep) < gk::epsilon) {
+			out.pop_back();
+		}
+	}
 
 	// normalize
-	for (auto &angle : angles) {
-		if (angle > gk::epsilon) {
-			angle = angle / (2.0 * numbers::pi);
-		}
+	for (auto iter = out.begin() + begin; iter != out.end(); iter++) {
+		*iter /= sweep;
 	}
 
 	// info print
 #ifdef debug
 	std::cout << "Angles: ";
-	for (double angle : angles) {
-			std::cout << angle << " ";
+	for (auto iter = out.begin() + begin; iter != out.end(); iter++) {
+			std::cout << *iter << " ";
 	}
 	std::cout << std::endl;
-	std::cout << "start angle: " << start_angle << std::endl;
-	std::cout << "dir angle: " << dir_angle << std::endl;
-	cout << "clockwise: " << direction_clockwise << endl;
+	cout << "clockwise: " << clockwise << endl;
 #endif
+}
+
+void line_ticks(const Line2 &line, const Vec2 &A,
+								const std::vector<double> &values,
+								std::vector<RelationTick> &out) {
+	Vec2 B = line_from_a(line, A) ? line.B : line.A;
+	Vec2 d = B - A;
+	Vec2 normal = Vec2{-d.y, d.x}.norm();
+	for (double value : values) {
+		out.push_back(RelationTick{A + d * value, normal});
+	}
+}
+
+void angular_ticks(const Vec2 &C, const Vec2 &start, const bool clockwise,
+									 const double sweep, const std::vector<double> &values,
+									 std::vector<RelationTick> &out) {
+	Vec2 s = start - C;
+	// s turned a quarter in the direction of travel
+	Vec2 t = clockwise ? Vec2{-s.y, s.x} : Vec2{s.y, -s.x};
+	double radius = std::hypot(s.x, s.y);
+	for (double value : values) {
+		double angle = value * sweep;
+		Vec2 v = s * std::cos(angle) + t * std::sin(angle);
+		out.push_back(RelationTick{C + v, v * (1.0 / radius)});
+	}
+}
 
+void diff_values(const int id, const std::vector<double> &old,
+								 const std::vector<double> &now,
+								 std::vector<RelationChange> &out) {
+	const double missing = std::numeric_limits<double>::quiet_NaN();
+	size_t n = std::max(old.size(), now.size());
+	for (size_t i = 0; i < n; i++) {
+		double old_value = i < old.size() ? old[i] : missing;
+		double new_value = i < now.size() ? now[i] : missing;
+		if (old_value != new_value) {
+			out.push_back(RelationChange{id, static_cast<uint32_t>(i), old_value,
+				new_value});
+		}
+	}
+}
+
+void write_changes(const uint64_t generation,
+									 const std::vector<RelationChange> &changes,
+									 std::ostream &out) {
+	std::string buffer = "generation ";
+	char number[32];
+	auto append = [&](const auto value) {
+		auto [end, ec] = std::to_chars(number, number + sizeof(number), value);
+		buffer.append(number, end);
+	};
+	auto append_value = [&](const double value) {
+		if (std::isnan(value)) {
+			buffer += '-';
+		} else {
+			append(value);
+		}
+	};
+	append(generation);
+	buffer += '\n';
+	for (const RelationChange &change : changes) {
+		append(change.shape_id);
+		buffer += ' ';
+		append(change.index);
+		buffer += ' ';
+		append_value(change.old_value);
+		buffer += ' ';
+		append_value(change.new_value);
+		buffer += '\n';
+	}
+	out.write(buffer.data(), buffer.size());
+	out.flush();
+}
+} // namespace detail
+
+std::pmr::vector<double> line_relations(Shapes &shapes, GenLine &gen_line) {
+	const Line *line = shapes.get_line_by_id(gen_line.id);
+	if (!line) {
+		return {};
+	}
+	if (!shapes.node_index.built) {
+		nodes::detail::index_nodes(shapes);
+	}
+	std::pmr::vector<double> distances{arena::frame()};
+	detail::line_kernel(shapes, line->id, line->geom, gen_line.start_point,
+											distances);
+	return distances;
+}
+
+// TODO: function should take some point on the circle as arg
+std::pmr::vector<double> circle_relations(Shapes &shapes,
+																								 GenCircle &gen_circle) {
+	const Circle *circle = shapes.get_circle_by_id(gen_circle.id);
+	if (!circle) {
+		return {};
+	}
+	if (!shapes.node_index.built) {
+		nodes::detail::index_nodes(shapes);
+	}
+	bool clockwise = detail::circle_clockwise(circle->geom,
+		gen_circle.start_point, gen_circle.dir_point);
+	std::pmr::vector<double> angles{arena::frame()};
+	detail::angular_kernel(shapes, circle->id, circle->geom.C,
+												 gen_circle.start_point, clockwise, nullptr, angles);
 	return angles;
 }
 
-vector<double> arc_relations(Shapes &shapes, GenArc &gen) {
-	// bool direction_clockwise = false;
-	// vector<double> angles {};
-	// vector<double> angle_relations {};
-
-	// // fill all points into vector, if a point is selected put in front
-	// for (auto &ixn_point : shapes.ixn_points) {
-	// 	if (ixn_point.flags.highlighted && std::any_of(ixn_point.ids.begin(), ixn_point.ids.end(),
-	// 									[&](const auto &id) { return id == gen.arc.id; })) {
-	// 		angles.push_back(gen.arc.get_angle_of_point(ixn_point.p));
-	// 	}
-	// }
-
-	// // determine direction
-	// double start_angle = gen.arc.get_angle_of_point(gen.start_point);
-	// double dir_angle = gen.arc.get_angle_of_point(gen.dir_point);
-	// double start_angle_opposite {};
-	// if (start_angle > numbers::pi) {
-	// 	start_angle_opposite = start_angle - numbers::pi;
-	// 	if (dir_angle >= start_angle || dir_angle < start_angle_opposite) {
-	// 		// counter clockwise
-	// 		direction_clockwise = false;
-	// 		sort(angles.begin(), angles.end(),
-	// 			[](double a1, double a2) { return a1 < a2; });
-	// 	} else {
-	// 		// clockwise
-	// 		direction_clockwise = true;
-	// 		sort(angles.begin(), angles.end(),
-	// 			[](double a1, double a2) { return a1 > a2; });
-	// 	}
-	// } else {
-	// 	start_angle_opposite = start_angle + numbers::pi;
-	// 	if (dir_angle >= start_angle && dir_angle < start_angle_opposite) {
-	// 		// counter clockwise
-	// 		direction_clockwise = false;
-	// 		sort(angles.begin(), angles.end(),
-	// 			[](double a1, double a2) { return a1 < a2; });
-	// 	} else {
-	// 		// clockwise
-	// 		direction_clockwise = true;
-	// 		sort(angles.begin(), angles.end(),
-	// 			[](double a1, double a2) { return a1 > a2; });
-	// 	}
-	// }
-
-	// // Print the rotated vector
-	// std::cout << "Sorted vector: ";
-	// for (double angle : angles) {
-	// 		std::cout << angle << " ";
-	// }
-	// std::cout << std::endl;
-
-	// auto iter = find(angles.begin(), angles.end(), start_angle);
-	// rotate(angles.begin(), iter, angles.end());
-
-	// // Print the rotated vector
-	// std::cout << "Rotated vector: ";
-	// for (double angle : angles) {
-	// 		std::cout << angle << " ";
-	// }
-	// std::cout << std::endl;
-
-	// vector<double> final_angles {};
-	// double final_angle {};
-
-	// for (auto &angle : angles) {
-	// 	if (direction_clockwise) {
-	// 		if (angle <= angles.at(0)) {
-	// 			final_angle = angles.at(0) - angle;
-	// 		} else {
-	// 			final_angle = (2 * numbers::pi - angle) + angles.at(0);
-	// 		}
-	// 	} else {
-	// 		if (angle >= angles.at(0)) {
-	// 			final_angle = angle - angles.at(0);
-	// 		} else {
-	// 			final_angle = (2 * numbers::pi + angle) - angles.at(0);
-	// 		}
-	// 	}
-	// 	final_angle /= (2 * numbers::pi);
-	// 	final_angles.push_back(final_angle);
-	// }
-	// return final_angles;
+std::pmr::vector<double> arc_relations(Shapes &shapes, GenArc &gen_arc) {
+	const Arc *arc = shapes.get_arc_by_id(gen_arc.id);
+	if (!arc) {
+		return {};
+	}
+	if (!shapes.node_index.built) {
+		nodes::detail::index_nodes(shapes);
+	}
+	bool clockwise = detail::circle_clockwise(arc->geom.to_circle(),
+		gen_arc.start_point, gen_arc.dir_point);
+	std::pmr::vector<double> angles{arena::frame()};
+	detail::angular_kernel(shapes, arc->id, arc->geom.C, gen_arc.start_point,
+												 clockwise, &arc->geom, angles);
+	return angles;
 }
 
 void calculate_relations(Shapes &shapes, GenShapes &gen_shapes,
-                         std::ofstream &file_out) {
+												 RelationWriter &writer, const bool echo) {
 	// +1 after every shape, need refactor if i want to incoperate shape size
 	int relation_depth = 0;
-	std::vector<double> relations{};
-	cout << "Relations: " << endl;
+	std::pmr::vector<double> relations{arena::frame()};
+	if (echo) {
+		cout << "Relations: " << endl;
+	}
 	for (auto [shape_type, index] : gen_shapes.selection_order) {
+		const Shape *shape = nullptr;
+		Vec2 start {};
+		bool clockwise = false;
 		switch (shape_type) {
-			case ShapeType::LINE:
+			case ShapeType::LINE: {
         assert(index < gen_shapes.lines.size());
-				relations = gen::line_relations(shapes, gen_shapes.lines[index]);
+				GenLine &gen_line = gen_shapes.lines[index];
+				relations = gen::line_relations(shapes, gen_line);
+				shape = shapes.get_line_by_id(gen_line.id);
+				start = gen_line.start_point;
 				break;
-			case ShapeType::CIRCLE:
+			}
+			case ShapeType::CIRCLE: {
         assert(index < gen_shapes.circles.size());
-				relations = gen::circle_relations(shapes, gen_shapes.circles[index]);
+				GenCircle &gen_circle = gen_shapes.circles[index];
+				relations = gen::circle_relations(shapes, gen_circle);
+				const Circle *circle = shapes.get_circle_by_id(gen_circle.id);
+				shape = circle;
+				start = gen_circle.start_point;
+				clockwise = circle && detail::circle_clockwise(circle->geom,
+					gen_circle.start_point, gen_circle.dir_point);
 				break;
-			case ShapeType::ARC:
+			}
+			case ShapeType::ARC: {
         assert(index < gen_shapes.arcs.size());
-				relations = gen::arc_relations(shapes, gen_shapes.arcs[index]);
+				GenArc &gen_arc = gen_shapes.arcs[index];
+				relations = gen::arc_relations(shapes, gen_arc);
+				const Arc *arc = shapes.get_arc_by_id(gen_arc.id);
+				shape = arc;
+				start = gen_arc.start_point;
+				clockwise = arc && detail::circle_clockwise(arc->geom.to_circle(),
+					gen_arc.start_point, gen_arc.dir_point);
 				break;
+			}
 			default:
 				std::exit(EXIT_FAILURE);
 		}
+		if (gen_shapes.feed && shape) {
+			relfeed::publish(*gen_shapes.feed, shape->id, shape_type,
+				RELFEED_SOURCE_SEQUENCE, static_cast<uint16_t>(relation_depth),
+				relations.data(), relations.size());
+		}
 
-		for (auto &relation : relations) {
-			file_out << relation + relation_depth << " ";
-			cout << relation + relation_depth << ", ";
+		// a shape that is gone keeps its place as an empty record
+		Relation relation{shape ? shape->id : -1,
+			shape ? shape_type : ShapeType::NONE, start, clockwise, 0,
+			static_cast<uint32_t>(relations.size()),
+			static_cast<uint32_t>(relation_depth)};
+		relstream::write(writer, relation, relations.data());
+		if (echo) {
+			for (auto &value : relations) {
+				cout << value + relation_depth << ", ";
+			}
+			cout << endl;
 		}
-		cout << endl;
 
 		relation_depth++;
 	}
 }
 
+bool calculate_relations(Shapes &shapes, GenShapes &gen_shapes,
+												 const std::string &path, const bool echo) {
+	RelationWriter writer;
+	if (!relstream::begin(writer, path)) {
+		std::cerr << "couldn't open " << path << std::endl;
+		return false;
+	}
+	calculate_relations(shapes, gen_shapes, writer, echo);
+	uint64_t n_records = writer.header.n_records;
+	if (!relstream::finish(writer)) {
+		return false;
+	}
+	cout << "relations: " << n_records << " to " << path << endl;
+	return true;
+}
+
+void update_preview(Shapes &shapes, GenShapes &gen_shapes,
+										std::vector<RelationChange> *changes) {
+	if (!shapes.node_index.built) {
+		nodes::detail::index_nodes(shapes);
+	}
+	// the preview of a deleted shape goes, its values count as removed. a
+	// shape out of the store for an edit keeps its ticks until it is back
+	auto current = [&](GenPreview &preview, const Shape *shape) {
+		if (!shape && shapes.edit.in_edit) {
+			return true;
+		}
+		if (!shape) {
+			if (changes && preview.valid) {
+				detail::diff_values(preview.shape_id, preview.relations, {}, *changes);
+			}
+			preview = GenPreview{};
+			return true;
+		}
+		return preview.valid &&
+					 preview.revision == nodes::revision(shapes, shape->id);
+	};
+	auto replace = [&](GenPreview &preview, const Shape &shape,
+										 const ShapeType type,
+										 const std::pmr::vector<double> &relations) {
+		if (gen_shapes.feed) {
+			relfeed::publish(*gen_shapes.feed, shape.id, type, RELFEED_SOURCE_LIVE, 0,
+											 relations.data(), relations.size());
+		}
+		std::vector<double> old = std::move(preview.relations);
+		preview.relations.assign(relations.begin(), relations.end());
+		preview.ticks.clear();
+		preview.shape_id = shape.id;
+		preview.revision = nodes::revision(shapes, shape.id);
+		preview.valid = true;
+		if (changes) {
+			detail::diff_values(shape.id, old, preview.relations, *changes);
+		}
+	};
+	for (auto &gen_line : gen_shapes.lines) {
+		GenPreview &preview = gen_line.preview;
+		const Line *line = shapes.get_line_by_id(gen_line.id);
+		if (current(preview, line)) {
+			continue;
+		}
+		replace(preview, *line, ShapeType::LINE, line_relations(shapes, gen_line));
+		detail::line_ticks(line->geom, gen_line.start_point, preview.relations,
+											 preview.ticks);
+	}
+	for (auto &gen_circle : gen_shapes.circles) {
+		GenPreview &preview = gen_circle.preview;
+		const Circle *circle = shapes.get_circle_by_id(gen_circle.id);
+		if (current(preview, circle)) {
+			continue;
+		}
+		replace(preview, *circle, ShapeType::CIRCLE,
+						circle_relations(shapes, gen_circle));
+		bool clockwise = detail::circle_clockwise(circle->geom,
+			gen_circle.start_point, gen_circle.dir_point);
+		detail::angular_ticks(circle->geom.C, gen_circle.start_point, clockwise,
+													2.0 * numbers::pi, preview.relations, preview.ticks);
+	}
+	for (auto &gen_arc : gen_shapes.arcs) {
+		GenPreview &preview = gen_arc.preview;
+		const Arc *arc = shapes.get_arc_by_id(gen_arc.id);
+		if (current(preview, arc)) {
+			continue;
+		}
+		replace(preview, *arc, ShapeType::ARC, arc_relations(shapes, gen_arc));
+		bool clockwise = detail::circle_clockwise(arc->geom.to_circle(),
+			gen_arc.start_point, gen_arc.dir_point);
+		detail::angular_ticks(arc->geom.C, gen_arc.start_point, clockwise,
+													detail::arc_sweep(arc->geom), preview.relations,
+													preview.ticks);
+	}
+}
+
+bool start_diff(Shapes &shapes, const GenShapes &gen_shapes, RelationDiff &diff,
+								const std::string &path) {
+	if (gen_shapes.selection_order.empty()) {
+		return false;
+	}
+	diff.out = std::ofstream{path};
+	if (!diff.out) {
+		std::cerr << "couldn't open " << path << std::endl;
+		return false;
+	}
+	diff.sources = gen_shapes;
+	diff.sources.feed = nullptr;
+	for (auto &gen_line : diff.sources.lines) { gen_line.preview = GenPreview{}; }
+	for (auto &gen_circle : diff.sources.circles) { gen_circle.preview = GenPreview{}; }
+	for (auto &gen_arc : diff.sources.arcs) { gen_arc.preview = GenPreview{}; }
+	diff.generation = 0;
+	diff.enabled = true;
+	update_diff(shapes, diff);
+	return true;
+}
+
+void stop_diff(RelationDiff &diff) {
+	diff.out.close();
+	diff.sources = GenShapes{};
+	diff.changes.clear();
+	diff.enabled = false;
+}
+
+void update_diff(Shapes &shapes, RelationDiff &diff) {
+	if (!diff.enabled) {
+		return;
+	}
+	if (shapes.edit.in_edit) {
+		return;
+	}
+	diff.changes.clear();
+	update_preview(shapes, diff.sources, &diff.changes);
+	if (!diff.changes.empty()) {
+		detail::write_changes(diff.generation, diff.changes, diff.out);
+		diff.generation++;
+	}
+}
+
+// one chunk in one thread, the origin buffer is reused for every shape
+void detail::batch_chunk_relations(const Shapes &shapes,
+																	 const std::vector<int> &ids,
+																	 const size_t begin, const size_t end,
+																	 RelationBatch &out) {
+	std::pmr::vector<Vec2> points;
+	auto push = [&](const int id, const ShapeType type, const Vec2 &origin,
+									const bool clockwise, const size_t values_begin) {
+		out.relations.push_back(Relation{id, type, origin, clockwise,
+			static_cast<uint32_t>(values_begin),
+			static_cast<uint32_t>(out.values.size() - values_begin)});
+	};
+	for (size_t i = begin; i < end; i++) {
+		const int id = ids[i];
+		points.clear();
+		detail::incident_points(shapes, id, points);
+		const ShapeSlot slot = shapes.by_id[id];
+		if (slot.type == ShapeType::LINE) {
+			const Line *line = shapes.lines.get(slot.handle);
+			if (!line || line->pflags.concealed) { continue; }
+			std::pmr::vector<Vec2> origins{line->geom.A, line->geom.B};
+			origins.insert(origins.end(), points.begin(), points.end());
+			for (const Vec2 &origin : origins) {
+				size_t values_begin = out.values.size();
+				detail::line_kernel(shapes, id, line->geom, origin, out.values);
+				push(id, ShapeType::LINE, origin, false, values_begin);
+			}
+		} else if (slot.type == ShapeType::CIRCLE) {
+			const Circle *circle = shapes.circles.get(slot.handle);
+			if (!circle || circle->pflags.concealed) { continue; }
+			for (const Vec2 &origin : points) {
+				for (bool clockwise : {false, true}) {
+					size_t values_begin = out.values.size();
+					detail::angular_kernel(shapes, id, circle->geom.C, origin, clockwise,
+																 nullptr, out.values);
+					push(id, ShapeType::CIRCLE, origin, clockwise, values_begin);
+				}
+			}
+		} else if (slot.type == ShapeType::ARC) {
+			const Arc *arc = shapes.arcs.get(slot.handle);
+			if (!arc || arc->pflags.concealed) { continue; }
+			// the ends only in the direction onto the arc
+			auto emit = [&](const Vec2 &origin, const bool clockwise) {
+				size_t values_begin = out.values.size();
+				detail::angular_kernel(shapes, id, arc->geom.C, origin, clockwise,
+															 &arc->geom, out.values);
+				push(id, ShapeType::ARC, origin, clockwise, values_begin);
+			};
+			emit(arc->geom.S, arc->geom.clockwise);
+			emit(arc->geom.E, !arc->geom.clockwise);
+			for (const Vec2 &origin : points) {
+				emit(origin, false);
+				emit(origin, true);
+			}
+		}
+	}
+}
+
+// chunks run through util::parallel_for like nodes::rebuild does
+void batch_relations(Shapes &shapes, std::vector<int> ids,
+										 std::vector<RelationBatch> &out) {
+	if (!shapes.node_index.built) {
+		nodes::detail::index_nodes(shapes);
+	}
+	if (ids.empty()) {
+		for (size_t id = 0; id < shapes.by_id.size(); id++) {
+			ids.push_back(static_cast<int>(id));
+		}
+	}
+	std::erase_if(ids, [&](const int id) {
+		return id < 0 || static_cast<size_t>(id) >= shapes.by_id.size();
+	});
+	size_t n_chunks = (ids.size() + batch_chunk - 1) / batch_chunk;
+	out.assign(n_chunks, {});
+	const Shapes &scene = shapes;
+	util::parallel_for(n_chunks, [&](const size_t k) {
+		detail::batch_chunk_relations(scene, ids, k * batch_chunk,
+			std::min(ids.size(), (k + 1) * batch_chunk), out[k]);
+	});
+}
+
+// numbers go through to_chars into a buffer that is handed to the stream
+// in large blocks, shortest form that reads back to the same double
+void write_relations(const std::vector<RelationBatch> &batches,
+										 std::ostream &out) {
+	constexpr size_t flush_size = size_t{1} << 20;
+	std::string buffer;
+	buffer.reserve(flush_size + 4096);
+	char number[32];
+	auto append = [&](const auto value) {
+		auto [end, ec] = std::to_chars(number, number + sizeof(number), value);
+		buffer.append(number, end);
+	};
+	for (const RelationBatch &batch : batches) {
+		for (const Relation &relation : batch.relations) {
+			append(relation.shape_id);
+			buffer += relation.type == ShapeType::LINE ? " L " :
+								relation.type == ShapeType::CIRCLE ? " C " :
+								relation.type == ShapeType::ARC ? " A " : " - ";
+			append(relation.origin.x);
+			buffer += ' ';
+			append(relation.origin.y);
+			buffer += relation.clockwise ? " 1 " : " 0 ";
+			append(relation.depth);
+			for (uint32_t i = 0; i < relation.count; i++) {
+				buffer += ' ';
+				append(batch.values[relation.begin + i]);
+			}
+			buffer += '\n';
+			if (buffer.size() >= flush_size) {
+				out.write(buffer.data(), buffer.size());
+				buffer.clear();
+			}
+		}
+	}
+	out.write(buffer.data(), buffer.size());
+	out.flush();
+}
+
+void calculate_batch_relations(Shapes &shapes, RelationWriter &writer) {
+	std::vector<int> ids;
+	for (size_t id = 0; id < shapes.by_id.size(); id++) {
+		if (shapes.shape_tflags.selected.test(id)) {
+			ids.push_back(static_cast<int>(id));
+		}
+	}
+	std::vector<RelationBatch> batches;
+	batch_relations(shapes, std::move(ids), batches);
+	relstream::write_batches(writer, batches);
+}
+
+bool calculate_batch_relations(Shapes &shapes, const std::string &path) {
+	RelationWriter writer;
+	if (!relstream::begin(writer, path)) {
+		std::cerr << "couldn't open " << path << std::endl;
+		return false;
+	}
+	calculate_batch_relations(shapes, writer);
+	uint64_t n_records = writer.header.n_records;
+	if (!relstream::finish(writer)) {
+		return false;
+	}
+	cout << "batch relations: " << n_records << " to " << path << endl;
+	return true;
+}
+
 } // namespace gen
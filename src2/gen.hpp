@@ -4,24 +4,48 @@
 #include "graphics.hpp"
 #include "app.hpp"
 #include "shapes.hpp"
+#include "relfeed.hpp"
+
+struct RelationWriter;
+
+// where a relation value lies on its shape, the tick is drawn along normal
+struct RelationTick {
+	Vec2 P {};
+	Vec2 normal {};
+};
+// live relations of a gen shape, computed again only when the node index
+// revision of the shape moved
+struct GenPreview {
+	std::vector<double> relations;
+	std::vector<RelationTick> ticks;
+	int shape_id {-1};
+	uint32_t revision = 0;
+	bool valid = false;
+};
 
 struct GenLine {
-	Line shape;
+	int id {-1};
 	Vec2 start_point {};
 	Vec2 dir_point {};
+	GenPreview preview {};
 };
 struct GenCircle {
-	Circle shape;
+	int id {-1};
 	Vec2 start_point {};
 	Vec2 dir_point {};
+	GenPreview preview {};
 };
 
 struct GenArc {
-	Arc shape;
+	int id {-1};
 	Vec2 start_point {};
 	Vec2 dir_point {};
+	GenPreview preview {};
 };
 
+// gen shapes refer to the live shapes by id, an edit or an undo adds its
+// shape back under the same id with a new handle. a shape deleted after
+// selection is skipped instead of read from a stale copy
 struct GenShapes {
 	std::vector<GenLine> lines;
 	std::vector<GenCircle> circles;
@@ -30,31 +54,173 @@ struct GenShapes {
 	bool origin_set = false;
 	Node origin{};
 
+	// type and index into the gen vector of that type, they only grow
+	// until clear
 	std::vector<std::pair<ShapeType, size_t>> selection_order;
+
+	// calculate_relations and the previews publish here if it is set
+	RelationFeed *feed = nullptr;
+};
+
+// one value of a relation vector that changed, old or new is NaN past the
+// end of the shorter vector
+struct RelationChange {
+	int shape_id {-1};
+	uint32_t index = 0;
+	double old_value = 0.0;
+	double new_value = 0.0;
+};
+
+// the gen shapes as they were when the diff mode was turned on, kept
+// across mode changes so edits in other modes are followed. every frame
+// in which their relations changed is one generation in out
+struct RelationDiff {
+	GenShapes sources;
+	std::vector<RelationChange> changes;
+	std::ofstream out;
+	uint64_t generation = 0;
+	bool enabled = false;
+};
+
+// relations of one shape from one origin node, values[begin, begin + count)
+// of the batch it is in. depth is the place of the shape in a gen
+// selection or the hop of a traversal, 0 in a batch over all shapes
+struct Relation {
+	int shape_id {-1};
+	ShapeType type = ShapeType::NONE;
+	Vec2 origin {};
+	bool clockwise = false;
+	uint32_t begin = 0;
+	uint32_t count = 0;
+	uint32_t depth = 0;
+};
+// results of one chunk of shapes
+struct RelationBatch {
+	std::vector<Relation> relations;
+	std::pmr::vector<double> values;
 };
 
 namespace gen {
+// shapes per unit of parallel work in batch_relations
+constexpr size_t batch_chunk = 64;
 namespace detail {
-template <typename GenT, typename ShapeT>
-bool shape_is_duplicate(const std::vector<GenT> &gen_shapes,
-                        const ShapeT &shape) {
+template <typename GenT>
+bool shape_is_duplicate(const std::vector<GenT> &gen_shapes, const int id) {
   return std::any_of(gen_shapes.begin(), gen_shapes.end(),
-                     [shape](const GenT &gen_shape) {
-                       return gen_shape.shape.id == shape.id;
+                     [id](const GenT &gen_shape) {
+                       return gen_shape.id == id;
                      });
 }
 void hl_nodes_of_shape(Shapes &shapes, int shape_id);
 void hl_gen_shapes_and_nodes(Shapes &shapes, GenShapes &gen_shapes);
-void set_origin(Shapes &shapes, GenShapes &gen_shapes, Node &node);
+void set_origin(Shapes &shapes, GenShapes &gen_shapes, ShapeType type,
+								size_t index);
+// positions of the visible ixn nodes of the shape, from node_index
+void incident_points(const Shapes &shapes, const int id,
+										 std::pmr::vector<Vec2> &out);
+// the kernels append to out, relations of the same shape from the same
+// origin are the same in the gen mode and the batch. they read the nodes
+// of the shape in nodes::params order and skip concealed ones, nothing is
+// measured per node or sorted
+// a start within gk::epsilon of A runs towards B, any other towards A
+bool line_from_a(const Line2 &line, const Vec2 &A);
+// distances from A to the nodes normalized by the distance to the far
+// end of the line, ascending: the nodes on both sides of A are merged
+// outwards from it. nodes within gk::epsilon of A are 0, the far end is
+// left out and 0 is always in
+void line_kernel(const Shapes &shapes, const int id, const Line2 &line,
+								 const Vec2 &A, std::pmr::vector<double> &out);
+// v in a frame with the start s on the x axis and the direction of
+// travel towards +y
+Vec2 to_travel_frame(const Vec2 &s, const Vec2 &v, const bool clockwise);
+// polar angle in [0, 2 pi)
+double travel_angle(const Vec2 &v);
+// dir lies in the half turn after start in the clockwise direction
+bool circle_clockwise(const Circle2 &circle, const Vec2 &start,
+											const Vec2 &dir);
+// S to E in the direction of the arc, a full turn if they meet
+double arc_sweep(const Arc2 &arc);
+// angles from start to the nodes around C in the given direction,
+// ascending, as fractions of a turn. the read starts at the angle of the
+// start and wraps once, nodes within gk::epsilon of it are 0. with an arc
+// only the nodes up to the end of the arc in that direction count, as
+// fractions of the arc, and like a line the start is always in and the
+// far end is not
+void angular_kernel(const Shapes &shapes, const int id, const Vec2 &C,
+										const Vec2 &start, const bool clockwise, const Arc2 *arc,
+										std::pmr::vector<double> &out);
+// inverse of the kernels for the preview. on a line the values are
+// distances, from an origin between the ends the nodes behind it show on
+// the side of the far end
+void line_ticks(const Line2 &line, const Vec2 &A,
+								const std::vector<double> &values,
+								std::vector<RelationTick> &out);
+void angular_ticks(const Vec2 &C, const Vec2 &start, const bool clockwise,
+									 const double sweep, const std::vector<double> &values,
+									 std::vector<RelationTick> &out);
+// appends the changes from old to now to out, see RelationChange
+void diff_values(const int id, const std::vector<double> &old,
+								 const std::vector<double> &now,
+								 std::vector<RelationChange> &out);
+// one generation: a line "generation n", then one line per change with
+// shape id, index, old and new value, - for NaN
+void write_changes(const uint64_t generation,
+									 const std::vector<RelationChange> &changes,
+									 std::ostream &out);
+// relations of shapes [begin, end) of ids from all their origins
+void batch_chunk_relations(const Shapes &shapes, const std::vector<int> &ids,
+													 const size_t begin, const size_t end,
+													 RelationBatch &out);
 } // namespace detail
 void maybe_select(Shapes &shapes, GenShapes &gen_shapes);
 
-std::vector<double> line_relations(Shapes &shapes, GenLine &gen);
-std::vector<double> circle_relations(Shapes &shapes, GenCircle &gen);
-std::vector<double> arc_relations(Shapes &shapes, GenArc &gen);
+// results are frame scratch from arena::frame()
+std::pmr::vector<double> line_relations(Shapes &shapes, GenLine &gen);
+std::pmr::vector<double> circle_relations(Shapes &shapes, GenCircle &gen);
+std::pmr::vector<double> arc_relations(Shapes &shapes, GenArc &gen_arc);
 
+// one record per gen shape in selection order, see relstream.hpp. the
+// k-th record has depth k, a shape that is gone leaves an empty record
+// of type NONE. the values plus their depth are printed if echo is set
 void calculate_relations(Shapes &shapes, GenShapes &gen_shapes,
-                         std::ofstream &file_out);
+												 RelationWriter &writer, const bool echo = false);
+// a stream of its own at path, false if it does not open
+bool calculate_relations(Shapes &shapes, GenShapes &gen_shapes,
+												 const std::string &path, const bool echo = false);
+// once per frame in the gen mode, only gen shapes whose nodes changed
+// since their last preview are computed, an edited shape is computed
+// again once it is back and deleted shapes lose theirs. the
+// values that differ from the last preview go to changes if it is set
+void update_preview(Shapes &shapes, GenShapes &gen_shapes,
+										std::vector<RelationChange> *changes = nullptr);
+
+// the first generation has every value as new, false if path does not
+// open or there is no gen shape
+bool start_diff(Shapes &shapes, const GenShapes &gen_shapes, RelationDiff &diff,
+								const std::string &path);
+void stop_diff(RelationDiff &diff);
+// once per frame after the nodes are up to date, writes a generation
+// when a value changed. nothing is written while an edit has a shape out
+// of the store, a shape counts as removed once its id is gone
+void update_diff(Shapes &shapes, RelationDiff &diff);
+
+// relations of every unconcealed shape in ids, of all shapes if ids is
+// empty. lines go from both ends and every visible node on them, circles
+// from every visible node on them in both directions, arcs from both ends
+// onto the arc and from every visible node on them in both directions. the
+// chunks run in parallel, out[k] holds the shapes
+// [k * batch_chunk, (k + 1) * batch_chunk) of ids
+void batch_relations(Shapes &shapes, std::vector<int> ids,
+										 std::vector<RelationBatch> &out);
+// one text line per relation: shape id, L, C or A (- for an empty
+// record), origin, 1 if clockwise, depth, values
+void write_relations(const std::vector<RelationBatch> &batches,
+										 std::ostream &out);
+// the selected shapes or all of them if none is selected into a binary
+// relation stream, see relstream.hpp
+void calculate_batch_relations(Shapes &shapes, RelationWriter &writer);
+// a stream of its own at path, false if it does not open
+bool calculate_batch_relations(Shapes &shapes, const std::string &path);
 
 // reset origin and others
 void reset(Shapes &shapes, GenShapes &gen_shapes);
@@ -0,0 +1,203 @@
+#include "geometry.hpp"
+
+namespace geometry {
+namespace detail {
+// the kernels write a 0/1 mask without branches so the compiler can
+// vectorize them, the compaction runs separately
+uint8_t *mask_buffer(const size_t n) {
+	thread_local std::vector<uint8_t> mask;
+	if (mask.size() < n) {
+		mask.resize(n);
+	}
+	return mask.data();
+}
+
+void compact(const uint8_t *mask, const size_t first, const size_t n,
+						 std::vector<uint32_t> &out) {
+	for (size_t j = first; j < n; j++) {
+		if (mask[j]) {
+			out.push_back(static_cast<uint32_t>(j));
+		}
+	}
+}
+
+template <typename Vec>
+void swap_remove(Vec &v, const size_t index) {
+	v[index] = v.back();
+	v.pop_back();
+}
+} // namespace detail
+
+void append(LineGeometry &g, const Line2 &line) {
+	g.ax.push_back(line.A.x);
+	g.ay.push_back(line.A.y);
+	g.bx.push_back(line.B.x);
+	g.by.push_back(line.B.y);
+}
+void append(CircleGeometry &g, const Circle2 &circle) {
+	g.cx.push_back(circle.C.x);
+	g.cy.push_back(circle.C.y);
+	g.r.push_back(circle.radius());
+}
+void append(ArcGeometry &g, const Arc2 &arc) {
+	g.cx.push_back(arc.C.x);
+	g.cy.push_back(arc.C.y);
+	g.r.push_back(arc.radius());
+	g.sx.push_back(arc.S.x);
+	g.sy.push_back(arc.S.y);
+	g.ex.push_back(arc.E.x);
+	g.ey.push_back(arc.E.y);
+}
+
+void swap_remove(LineGeometry &g, const size_t index) {
+	assert(index < g.ax.size());
+	detail::swap_remove(g.ax, index);
+	detail::swap_remove(g.ay, index);
+	detail::swap_remove(g.bx, index);
+	detail::swap_remove(g.by, index);
+}
+void swap_remove(CircleGeometry &g, const size_t index) {
+	assert(index < g.cx.size());
+	detail::swap_remove(g.cx, index);
+	detail::swap_remove(g.cy, index);
+	detail::swap_remove(g.r, index);
+}
+void swap_remove(ArcGeometry &g, const size_t index) {
+	assert(index < g.cx.size());
+	detail::swap_remove(g.cx, index);
+	detail::swap_remove(g.cy, index);
+	detail::swap_remove(g.r, index);
+	detail::swap_remove(g.sx, index);
+	detail::swap_remove(g.sy, index);
+	detail::swap_remove(g.ex, index);
+	detail::swap_remove(g.ey, index);
+}
+
+void reserve(LineGeometry &g, const size_t n) {
+	for (auto *v : {&g.ax, &g.ay, &g.bx, &g.by}) { v->reserve(n); }
+}
+void reserve(CircleGeometry &g, const size_t n) {
+	for (auto *v : {&g.cx, &g.cy, &g.r}) { v->reserve(n); }
+}
+void reserve(ArcGeometry &g, const size_t n) {
+	for (auto *v : {&g.cx, &g.cy, &g.r, &g.sx, &g.sy, &g.ex, &g.ey}) {
+		v->reserve(n);
+	}
+}
+
+void clear(Geometry &g) {
+	g = Geometry{};
+}
+
+bool in_sync(const Shapes &shapes) {
+	const Geometry &g = shapes.geometry;
+	for (size_t i = 0; i < shapes.lines.size(); i++) {
+		const Line2 &line = shapes.lines[i].geom;
+		if (g.lines.ax[i] != line.A.x || g.lines.ay[i] != line.A.y ||
+				g.lines.bx[i] != line.B.x || g.lines.by[i] != line.B.y) {
+			return false;
+		}
+	}
+	for (size_t i = 0; i < shapes.circles.size(); i++) {
+		const Circle2 &circle = shapes.circles[i].geom;
+		if (g.circles.cx[i] != circle.C.x || g.circles.cy[i] != circle.C.y) {
+			return false;
+		}
+	}
+	for (size_t i = 0; i < shapes.arcs.size(); i++) {
+		const Arc2 &arc = shapes.arcs[i].geom;
+		if (g.arcs.cx[i] != arc.C.x || g.arcs.cy[i] != arc.C.y) {
+			return false;
+		}
+	}
+	return g.lines.ax.size() == shapes.lines.size() &&
+				 g.circles.cx.size() == shapes.circles.size() &&
+				 g.arcs.cx.size() == shapes.arcs.size();
+}
+
+void segments_crossing(const LineGeometry &g, const size_t i,
+											 const size_t first, std::vector<uint32_t> &out) {
+	const size_t n = g.ax.size();
+	if (first >= n) { return; }
+	const double m = candidate_margin;
+	const double min_x = std::min(g.ax[i], g.bx[i]) - m;
+	const double max_x = std::max(g.ax[i], g.bx[i]) + m;
+	const double min_y = std::min(g.ay[i], g.by[i]) - m;
+	const double max_y = std::max(g.ay[i], g.by[i]) + m;
+	const double *ax = g.ax.data(), *ay = g.ay.data();
+	const double *bx = g.bx.data(), *by = g.by.data();
+	uint8_t *mask = detail::mask_buffer(n);
+	for (size_t j = first; j < n; j++) {
+		mask[j] = (std::min(ax[j], bx[j]) <= max_x) &
+							(std::max(ax[j], bx[j]) >= min_x) &
+							(std::min(ay[j], by[j]) <= max_y) &
+							(std::max(ay[j], by[j]) >= min_y);
+	}
+	detail::compact(mask, first, n, out);
+}
+
+void segments_near_circle(const LineGeometry &g, const Vec2 &C,
+													const double radius, std::vector<uint32_t> &out) {
+	const size_t n = g.ax.size();
+	if (n == 0) { return; }
+	const double m = candidate_margin;
+	const double reach = radius + m;
+	const double *ax = g.ax.data(), *ay = g.ay.data();
+	const double *bx = g.bx.data(), *by = g.by.data();
+	uint8_t *mask = detail::mask_buffer(n);
+	for (size_t j = 0; j < n; j++) {
+		// distance of C to the carrier line, squared and scaled by length^2
+		double vx = bx[j] - ax[j], vy = by[j] - ay[j];
+		double cross = vx * (C.y - ay[j]) - vy * (C.x - ax[j]);
+		double length_sq = vx * vx + vy * vy;
+		mask[j] = (cross * cross <= reach * reach * length_sq) &
+							(std::min(ax[j], bx[j]) <= C.x + reach) &
+							(std::max(ax[j], bx[j]) >= C.x - reach) &
+							(std::min(ay[j], by[j]) <= C.y + reach) &
+							(std::max(ay[j], by[j]) >= C.y - reach);
+	}
+	detail::compact(mask, 0, n, out);
+}
+
+void rings_near_segment(const std::vector<double> &cx,
+												const std::vector<double> &cy,
+												const std::vector<double> &r, const Vec2 &A,
+												const Vec2 &B, std::vector<uint32_t> &out) {
+	const size_t n = cx.size();
+	if (n == 0) { return; }
+	const double m = candidate_margin;
+	const double *px = cx.data(), *py = cy.data(), *pr = r.data();
+	const double vx = B.x - A.x, vy = B.y - A.y;
+	const double length_sq = vx * vx + vy * vy;
+	const double min_x = std::min(A.x, B.x), max_x = std::max(A.x, B.x);
+	const double min_y = std::min(A.y, B.y), max_y = std::max(A.y, B.y);
+	uint8_t *mask = detail::mask_buffer(n);
+	for (size_t j = 0; j < n; j++) {
+		double reach = pr[j] + m;
+		double cross = vx * (py[j] - A.y) - vy * (px[j] - A.x);
+		mask[j] = (cross * cross <= reach * reach * length_sq) &
+							(min_x <= px[j] + reach) & (max_x >= px[j] - reach) &
+							(min_y <= py[j] + reach) & (max_y >= py[j] - reach);
+	}
+	detail::compact(mask, 0, n, out);
+}
+
+void rings_crossing(const std::vector<double> &cx, const std::vector<double> &cy,
+										const std::vector<double> &r, const size_t first,
+										const Vec2 &C, const double radius,
+										std::vector<uint32_t> &out) {
+	const size_t n = cx.size();
+	if (first >= n) { return; }
+	const double m = candidate_margin;
+	const double *px = cx.data(), *py = cy.data(), *pr = r.data();
+	uint8_t *mask = detail::mask_buffer(n);
+	for (size_t j = first; j < n; j++) {
+		double dx = px[j] - C.x, dy = py[j] - C.y;
+		double d_sq = dx * dx + dy * dy;
+		double outer = pr[j] + radius + m;
+		double inner = std::max(std::abs(pr[j] - radius) - m, 0.0);
+		mask[j] = (d_sq <= outer * outer) & (d_sq >= inner * inner);
+	}
+	detail::compact(mask, first, n, out);
+}
+} // namespace geometry
@@ -0,0 +1,43 @@
+// geometry.hpp
+#pragma once
+#include "core.hpp"
+#include "graphics.hpp"
+#include "shapes.hpp"
+
+namespace geometry {
+// candidates are widened by this much so the exact tests in graphics::
+// never see fewer pairs than without the prefilter
+constexpr double candidate_margin = 1.0;
+
+void append(LineGeometry &g, const Line2 &line);
+void append(CircleGeometry &g, const Circle2 &circle);
+void append(ArcGeometry &g, const Arc2 &arc);
+// same swap with the last entry as SlotMap::erase
+void swap_remove(LineGeometry &g, const size_t index);
+void swap_remove(CircleGeometry &g, const size_t index);
+void swap_remove(ArcGeometry &g, const size_t index);
+void reserve(LineGeometry &g, const size_t n);
+void reserve(CircleGeometry &g, const size_t n);
+void reserve(ArcGeometry &g, const size_t n);
+void clear(Geometry &g);
+bool in_sync(const Shapes &shapes);
+
+// broadphase kernels, append indices >= first that may intersect
+// segments whose bounds overlap the bounds of segment i
+void segments_crossing(const LineGeometry &g, const size_t i,
+											 const size_t first, std::vector<uint32_t> &out);
+// segments that come closer to C than radius
+void segments_near_circle(const LineGeometry &g, const Vec2 &C,
+													const double radius, std::vector<uint32_t> &out);
+// circles (or arc carriers) that come closer to the segment A B than
+// their radius, the same pairs as segments_near_circle from their side
+void rings_near_segment(const std::vector<double> &cx,
+												const std::vector<double> &cy,
+												const std::vector<double> &r, const Vec2 &A,
+												const Vec2 &B, std::vector<uint32_t> &out);
+// circles (or arc carriers) whose ring crosses the ring around C
+void rings_crossing(const std::vector<double> &cx, const std::vector<double> &cy,
+										const std::vector<double> &r, const size_t first,
+										const Vec2 &C, const double radius,
+										std::vector<uint32_t> &out);
+} // namespace geometry
@@ -0,0 +1,267 @@
+#include "graph.hpp"
+#include "nodes.hpp"
+#include "relstream.hpp"
+
+namespace graph {
+namespace detail {
+bool live(const Shapes &shapes, const int id) {
+	if (id < 0 || static_cast<size_t>(id) >= shapes.by_id.size()) {
+		return false;
+	}
+	const ShapeSlot slot = shapes.by_id[id];
+	const Shape *shape = nullptr;
+	if (slot.type == ShapeType::LINE) {
+		shape = shapes.lines.get(slot.handle);
+	} else if (slot.type == ShapeType::CIRCLE) {
+		shape = shapes.circles.get(slot.handle);
+	} else if (slot.type == ShapeType::ARC) {
+		shape = shapes.arcs.get(slot.handle);
+	}
+	return shape && !shape->pflags.concealed;
+}
+
+void emit(const Shapes &shapes, const int id, const Vec2 &entry,
+					const std::optional<bool> direction, RelationBatch &out) {
+	auto push = [&](const ShapeType type, const bool clockwise,
+									const size_t values_begin) {
+		out.relations.push_back(Relation{id, type, entry, clockwise,
+			static_cast<uint32_t>(values_begin),
+			static_cast<uint32_t>(out.values.size() - values_begin)});
+	};
+	std::array<bool, 2> directions{false, true};
+	size_t n_directions = directions.size();
+	if (direction) {
+		directions[0] = *direction;
+		n_directions = 1;
+	}
+
+	const ShapeSlot slot = shapes.by_id[id];
+	if (slot.type == ShapeType::LINE) {
+		const Line *line = shapes.lines.get(slot.handle);
+		size_t values_begin = out.values.size();
+		gen::detail::line_kernel(shapes, id, line->geom, entry, out.values);
+		push(ShapeType::LINE, false, values_begin);
+	} else if (slot.type == ShapeType::CIRCLE) {
+		const Circle *circle = shapes.circles.get(slot.handle);
+		for (size_t d = 0; d < n_directions; d++) {
+			const bool clockwise = directions[d];
+			size_t values_begin = out.values.size();
+			gen::detail::angular_kernel(shapes, id, circle->geom.C, entry, clockwise,
+																	nullptr, out.values);
+			push(ShapeType::CIRCLE, clockwise, values_begin);
+		}
+	} else if (slot.type == ShapeType::ARC) {
+		const Arc *arc = shapes.arcs.get(slot.handle);
+		for (size_t d = 0; d < n_directions; d++) {
+			const bool clockwise = directions[d];
+			size_t values_begin = out.values.size();
+			gen::detail::angular_kernel(shapes, id, arc->geom.C, entry, clockwise,
+																	&arc->geom, out.values);
+			push(ShapeType::ARC, clockwise, values_begin);
+		}
+	}
+}
+
+bool clockwise_towards(const Shapes &shapes, const int id, const Vec2 &entry,
+											 const Vec2 &exit) {
+	const ShapeSlot slot = shapes.by_id[id];
+	if (slot.type == ShapeType::CIRCLE) {
+		const Circle *circle = shapes.circles.get(slot.handle);
+		return gen::detail::circle_clockwise(circle->geom, entry, exit);
+	}
+	if (slot.type == ShapeType::ARC) {
+		const Arc2 &arc = shapes.arcs.get(slot.handle)->geom;
+		Vec2 s = entry - arc.C;
+		double to_exit = gen::detail::travel_angle(
+			gen::detail::to_travel_frame(s, exit - arc.C, arc.clockwise));
+		double to_end = gen::detail::travel_angle(
+			gen::detail::to_travel_frame(s, arc.E - arc.C, arc.clockwise));
+		return to_exit <= to_end + gk::epsilon ? arc.clockwise : !arc.clockwise;
+	}
+	return false;
+}
+
+// the entry itself only if the shapes meet nowhere else
+bool find_exit(const Shapes &shapes, const IncidenceGraph &graph, const int id,
+							 const int next, const Vec2 &entry, Vec2 &exit) {
+	bool found = false;
+	double best = std::numeric_limits<double>::max();
+	for (uint32_t i = graph.shape_begin[id]; i < graph.shape_begin[id + 1]; i++) {
+		uint32_t k = graph.shape_nodes[i];
+		auto begin = graph.node_shapes.begin() + graph.node_begin[k];
+		auto end = graph.node_shapes.begin() + graph.node_begin[k + 1];
+		if (std::find(begin, end, next) == end) {
+			continue;
+		}
+		const Vec2 &P = shapes.ixn_points[k].P;
+		double distance = vec2::distance(entry, P);
+		if (distance <= gk::epsilon) {
+			distance = std::numeric_limits<double>::max();
+		}
+		if (!found || distance < best) {
+			found = true;
+			best = distance;
+			exit = P;
+		}
+	}
+	return found;
+}
+} // namespace detail
+
+// one counting pass over the node rows gives the shape rows
+void build(const Shapes &shapes, IncidenceGraph &out) {
+	size_t n_shapes = shapes.by_id.size();
+	std::vector<bool> live(n_shapes);
+	for (size_t id = 0; id < n_shapes; id++) {
+		live[id] = detail::live(shapes, static_cast<int>(id));
+	}
+	const std::vector<Node> &nodes = shapes.ixn_points;
+	out.node_begin.assign(1, 0);
+	out.node_begin.reserve(nodes.size() + 1);
+	out.node_shapes.clear();
+	out.shape_begin.assign(n_shapes + 1, 0);
+	for (const Node &node : nodes) {
+		if (!node.pflags.concealed) {
+			for (int id : node.ids) {
+				if (id >= 0 && static_cast<size_t>(id) < n_shapes && live[id]) {
+					out.node_shapes.push_back(id);
+					out.shape_begin[id + 1]++;
+				}
+			}
+		}
+		out.node_begin.push_back(static_cast<uint32_t>(out.node_shapes.size()));
+	}
+	for (size_t id = 0; id < n_shapes; id++) {
+		out.shape_begin[id + 1] += out.shape_begin[id];
+	}
+	out.shape_nodes.resize(out.node_shapes.size());
+	std::vector<uint32_t> cursor(out.shape_begin.begin(), out.shape_begin.end() - 1);
+	for (size_t k = 0; k < nodes.size(); k++) {
+		for (uint32_t i = out.node_begin[k]; i < out.node_begin[k + 1]; i++) {
+			out.shape_nodes[cursor[out.node_shapes[i]]++] = static_cast<uint32_t>(k);
+		}
+	}
+}
+
+// hops is the queue, a hop is expanded when its relations are emitted
+void breadth_first(const Shapes &shapes, const IncidenceGraph &graph,
+									 const Node &origin, Traversal &out) {
+	out = Traversal{};
+	std::vector<bool> shape_seen(graph.shape_begin.size() - 1, false);
+	std::vector<bool> node_seen(graph.node_begin.size() - 1, false);
+	for (int id : origin.ids) {
+		if (detail::live(shapes, id) && !shape_seen[id]) {
+			shape_seen[id] = true;
+			out.hops.push_back(Hop{id, 0, origin.P});
+		}
+	}
+	for (size_t h = 0; h < out.hops.size(); h++) {
+		const Hop hop = out.hops[h];
+		uint32_t first = static_cast<uint32_t>(out.batch.relations.size());
+		detail::emit(shapes, hop.shape_id, hop.entry, std::nullopt, out.batch);
+		out.hops[h].first = first;
+		out.hops[h].count = static_cast<uint32_t>(out.batch.relations.size()) - first;
+		for (uint32_t i = graph.shape_begin[hop.shape_id];
+				 i < graph.shape_begin[hop.shape_id + 1]; i++) {
+			uint32_t k = graph.shape_nodes[i];
+			if (node_seen[k]) { continue; }
+			node_seen[k] = true;
+			for (uint32_t j = graph.node_begin[k]; j < graph.node_begin[k + 1]; j++) {
+				int next = graph.node_shapes[j];
+				if (!shape_seen[next]) {
+					shape_seen[next] = true;
+					out.hops.push_back(Hop{next, hop.depth + 1, shapes.ixn_points[k].P});
+				}
+			}
+		}
+	}
+}
+
+bool along_path(const Shapes &shapes, const IncidenceGraph &graph,
+								const Node &origin, const std::vector<int> &path,
+								Traversal &out) {
+	out = Traversal{};
+	if (path.empty() || !shapes::id_match(origin.ids, path[0])) {
+		return false;
+	}
+	Vec2 entry = origin.P;
+	for (size_t i = 0; i < path.size(); i++) {
+		const int id = path[i];
+		if (!detail::live(shapes, id)) {
+			return false;
+		}
+		Hop hop{id, static_cast<uint32_t>(i), entry,
+			static_cast<uint32_t>(out.batch.relations.size())};
+		Vec2 exit {};
+		std::optional<bool> direction;
+		bool last = i + 1 == path.size();
+		if (!last) {
+			if (!detail::find_exit(shapes, graph, id, path[i + 1], entry, exit)) {
+				return false;
+			}
+			direction = detail::clockwise_towards(shapes, id, entry, exit);
+		}
+		detail::emit(shapes, id, entry, direction, out.batch);
+		hop.count = static_cast<uint32_t>(out.batch.relations.size()) - hop.first;
+		out.hops.push_back(hop);
+		entry = exit;
+	}
+	return true;
+}
+
+void write(const Traversal &traversal, RelationWriter &writer) {
+	const RelationBatch &batch = traversal.batch;
+	for (const Hop &hop : traversal.hops) {
+		for (uint32_t r = hop.first; r < hop.first + hop.count; r++) {
+			Relation relation = batch.relations[r];
+			relation.depth = hop.depth;
+			relstream::write(writer, relation,
+											 batch.values.data() + relation.begin);
+		}
+	}
+}
+
+bool calculate(Shapes &shapes, const GenShapes &gen_shapes,
+							 const std::string &path) {
+	if (!gen_shapes.origin_set) {
+		cout << "traversal needs an origin" << endl;
+		return false;
+	}
+	if (!shapes.node_index.built) {
+		nodes::detail::index_nodes(shapes);
+	}
+	IncidenceGraph graph;
+	build(shapes, graph);
+	Traversal traversal;
+	if (gen_shapes.selection_order.empty()) {
+		breadth_first(shapes, graph, gen_shapes.origin, traversal);
+	} else {
+		std::vector<int> ids;
+		for (auto [type, index] : gen_shapes.selection_order) {
+			if (type == ShapeType::LINE) {
+				ids.push_back(gen_shapes.lines[index].id);
+			} else if (type == ShapeType::CIRCLE) {
+				ids.push_back(gen_shapes.circles[index].id);
+			} else if (type == ShapeType::ARC) {
+				ids.push_back(gen_shapes.arcs[index].id);
+			}
+		}
+		if (!along_path(shapes, graph, gen_shapes.origin, ids, traversal)) {
+			cout << "path breaks off after " << traversal.hops.size() << " shapes"
+				<< endl;
+		}
+	}
+	RelationWriter writer;
+	if (!relstream::begin(writer, path)) {
+		std::cerr << "couldn't open " << path << std::endl;
+		return false;
+	}
+	write(traversal, writer);
+	if (!relstream::finish(writer)) {
+		return false;
+	}
+	cout << "traversal: " << traversal.hops.size() << " shapes, "
+		<< traversal.batch.relations.size() << " relations to " << path << endl;
+	return true;
+}
+} // namespace graph
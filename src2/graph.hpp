@@ -0,0 +1,67 @@
+// graph.hpp
+#pragma once
+#include "core.hpp"
+#include "gen.hpp"
+#include "shapes.hpp"
+
+// incidence of the visible ixn nodes and the unconcealed shapes in
+// compressed rows. the shapes of ixn node k are
+// node_shapes[node_begin[k], node_begin[k + 1]), the nodes of shape id are
+// shape_nodes[shape_begin[id], shape_begin[id + 1])
+struct IncidenceGraph {
+	std::vector<uint32_t> node_begin;
+	std::vector<int> node_shapes;
+	std::vector<uint32_t> shape_begin;
+	std::vector<uint32_t> shape_nodes;
+};
+
+// one shape reached by a traversal from the node it was entered at, its
+// relations are batch.relations[first, first + count)
+struct Hop {
+	int shape_id {-1};
+	uint32_t depth = 0;
+	Vec2 entry {};
+	uint32_t first = 0;
+	uint32_t count = 0;
+};
+struct Traversal {
+	std::vector<Hop> hops;
+	RelationBatch batch;
+};
+
+namespace graph {
+namespace detail {
+// the shape exists and is not concealed
+bool live(const Shapes &shapes, const int id);
+// relations of the shape from entry, in the given direction on circles
+// and arcs or in both if direction is empty. the nodes come from
+// node_index, which has to be built
+void emit(const Shapes &shapes, const int id, const Vec2 &entry,
+					const std::optional<bool> direction, RelationBatch &out);
+// the direction from entry that passes exit first, on an arc the one that
+// reaches it before the end
+bool clockwise_towards(const Shapes &shapes, const int id, const Vec2 &entry,
+											 const Vec2 &exit);
+// node of the shape that is also on next, the closest to entry. false if
+// the shapes do not meet
+bool find_exit(const Shapes &shapes, const IncidenceGraph &graph, const int id,
+							 const int next, const Vec2 &entry, Vec2 &exit);
+} // namespace detail
+void build(const Shapes &shapes, IncidenceGraph &out);
+// every shape reachable from the origin once, at the depth it is first
+// reached and from the node it is first reached at
+void breadth_first(const Shapes &shapes, const IncidenceGraph &graph,
+									 const Node &origin, Traversal &out);
+// the shapes of path in order, each from the node it shares with the one
+// before. path[0] has to be on the origin, false where the walk breaks off
+bool along_path(const Shapes &shapes, const IncidenceGraph &graph,
+								const Node &origin, const std::vector<int> &path,
+								Traversal &out);
+// one record per relation of every hop with the depth of the hop, the
+// format of gen::calculate_relations
+void write(const Traversal &traversal, RelationWriter &writer);
+// from the gen origin along the gen shapes in selection order or breadth
+// first if none is selected
+bool calculate(Shapes &shapes, const GenShapes &gen_shapes,
+							 const std::string &path);
+} // namespace graph
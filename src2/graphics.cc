@@ -99,9 +99,9 @@ bool angle_on_arc(const Arc2& arc, const double &angle) {
 		}
 	} else {
 		if (arc.E_angle > arc.S_angle) {
-			return angle < arc.S_angle && angle > arc.E_angle;
+			return angle > arc.S_angle && angle < arc.E_angle;
 		} else {
-			return angle < arc.S_angle || angle > arc.E_angle;
+			return angle > arc.S_angle || angle < arc.E_angle;
 		}
 	}
 }
@@ -112,7 +112,7 @@ void set_S(Arc2 &arc, const double &radius, const Vec2 &P) {
 } // namespace arc2
 
 namespace graphics {
-std::vector<Vec2> Line2_Line2_intersect(const Line2 &l1, const Line2 &l2) {
+IxnPoints Line2_Line2_intersect(const Line2 &l1, const Line2 &l2) {
   Vec2 l1_a = l1.get_a();
   Vec2 l2_v = l2.get_v();
 	// calculate the intersection point, check if denominator nears 0
@@ -127,13 +127,13 @@ std::vector<Vec2> Line2_Line2_intersect(const Line2 &l1, const Line2 &l2) {
 	// return if point is in line segment bounds
   if (line2::point_in_segment_bounds(l1, ixn_point) &&
       line2::point_in_segment_bounds(l2, ixn_point)) {
-    return std::vector<Vec2>{ixn_point};
+    return IxnPoints{ixn_point};
   } else {
-    return std::vector<Vec2>{};
+    return {};
   }
 }
 
-std::vector<Vec2> Line2_Circle2_intersect(const Line2 &l, const Circle2 &c) {
+IxnPoints Line2_Circle2_intersect(const Line2 &l, const Circle2 &c) {
 	Vec2 v_normal = (l.get_v()).norm();
 	double distance = line2::get_distance_point_to_ray(l, c.C);
 	// TODO maybe first check for equal with pixel_epsilon, then < 
@@ -146,7 +146,7 @@ std::vector<Vec2> Line2_Circle2_intersect(const Line2 &l, const Circle2 &c) {
 			center_to_line_projection.y - hight * v_normal.y};
 
 		// return ixn_points if within line segment bounds
-		std::vector<Vec2> ixn_points {};
+		IxnPoints ixn_points {};
 		if (line2::point_in_segment_bounds(l, ixn_point_1)) {
 			ixn_points.push_back(ixn_point_1);
 		}
@@ -155,11 +155,11 @@ std::vector<Vec2> Line2_Circle2_intersect(const Line2 &l, const Circle2 &c) {
 		}
 		return ixn_points;
 	} else {
-		return std::vector<Vec2>{};
+		return {};
 	}
 }
 
-std::vector<Vec2> Circle2_Circle2_intersect(const Circle2 &c1,
+IxnPoints Circle2_Circle2_intersect(const Circle2 &c1,
 																						const Circle2 &c2) {
 	// check if circles overlap
 	double c1_radius = c1.radius();
@@ -173,7 +173,7 @@ std::vector<Vec2> Circle2_Circle2_intersect(const Circle2 &c1,
 		if (center_distance < std::max(c1_radius, c2_radius)) {
 			if (std::min(c1.radius(), c2.radius()) <
 					(std::max(c1.radius(), c2.radius()) - center_distance)) {
-				return std::vector<Vec2> {};
+				return {};
 			}
 		}
 		double meet_distance =
@@ -187,44 +187,32 @@ std::vector<Vec2> Circle2_Circle2_intersect(const Circle2 &c1,
 		Vec2 ixn_point_1 = meet_point + h * a_normal;
 		Vec2 ixn_point_2 = meet_point -h * a_normal;
 
-		return std::vector<Vec2> {ixn_point_1, ixn_point_2};
+		return IxnPoints{ixn_point_1, ixn_point_2};
 	} else {
-		return std::vector<Vec2> {};
+		return {};
 	}
 }
-std::vector<Vec2> Arc2_Line2_intersect(const Arc2 &a, const Line2 &l) {
-	std::vector<Vec2> ixn_points = Line2_Circle2_intersect(l, a.to_circle());
-	for (auto iter = ixn_points.begin(); iter != ixn_points.end();) {
-		// careful with iterator erase and incrementing
-		if (!arc2::angle_on_arc(a, circle2::get_angle_of_point(a.to_circle(), *iter))) {
-			iter = ixn_points.erase(iter);
-		} else {
-			iter++;
-		}
-	}
+IxnPoints Arc2_Line2_intersect(const Arc2 &a, const Line2 &l) {
+	IxnPoints ixn_points = Line2_Circle2_intersect(l, a.to_circle());
+	ixn_points.keep_if([&](const Vec2 &P) {
+		return arc2::angle_on_arc(a, circle2::get_angle_of_point(a.to_circle(), P));
+	});
 	return ixn_points;
 }
-std::vector<Vec2> Arc2_Circle2_intersect(const Arc2 &a, const Circle2 &c) {
-	std::vector<Vec2> ixn_points = Circle2_Circle2_intersect(c, a.to_circle());
-	for (auto iter = ixn_points.begin(); iter != ixn_points.end();) {
-		if (!arc2::angle_on_arc(a, circle2::get_angle_of_point(a.to_circle(), *iter))) {
-			iter = ixn_points.erase(iter);
-		} else {
-			iter++;
-		}
-	}
+IxnPoints Arc2_Circle2_intersect(const Arc2 &a, const Circle2 &c) {
+	IxnPoints ixn_points = Circle2_Circle2_intersect(c, a.to_circle());
+	ixn_points.keep_if([&](const Vec2 &P) {
+		return arc2::angle_on_arc(a, circle2::get_angle_of_point(a.to_circle(), P));
+	});
 	return ixn_points;
 }
-std::vector<Vec2> Arc2_Arc2_intersect(const Arc2 &a1,	const Arc2 &a2) {
-	std::vector<Vec2> ixn_points =
+IxnPoints Arc2_Arc2_intersect(const Arc2 &a1,	const Arc2 &a2) {
+	IxnPoints ixn_points =
 		Circle2_Circle2_intersect(a1.to_circle(), a2.to_circle());
-	for (auto iter = ixn_points.begin(); iter != ixn_points.end();) {
-		if (!arc2::angle_on_arc(a1, circle2::get_angle_of_point(a1.to_circle(), *iter))) {
-			iter = ixn_points.erase(iter);
-		} else {
-			iter++;
-		}
-	}
+	ixn_points.keep_if([&](const Vec2 &P) {
+		return arc2::angle_on_arc(a1, circle2::get_angle_of_point(a1.to_circle(), P)) &&
+					 arc2::angle_on_arc(a2, circle2::get_angle_of_point(a2.to_circle(), P));
+	});
 	return ixn_points;
 }
 
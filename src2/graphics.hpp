@@ -78,11 +78,45 @@ bool angle_on_arc(const Arc2& arc, const double &angle);
 void set_S(Arc2 &arc, const double &radius, const Vec2 &P);
 } // namespace arc2
 
+// two curves of this kind meet in at most two points, kept inline so an
+// intersection test never touches the heap
+struct IxnPoints {
+	std::array<Vec2, 2> points{};
+	size_t count = 0;
+	IxnPoints() = default;
+	IxnPoints(std::initializer_list<Vec2> list) {
+		for (const Vec2 &P : list) { push_back(P); }
+	}
+	void push_back(const Vec2 &P) {
+		assert(count < points.size());
+		points[count++] = P;
+	}
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	Vec2 &at(const size_t i) { assert(i < count); return points[i]; }
+	const Vec2 &at(const size_t i) const { assert(i < count); return points[i]; }
+	Vec2 &back() { return at(count - 1); }
+	const Vec2 &back() const { return at(count - 1); }
+	Vec2 *begin() { return points.data(); }
+	Vec2 *end() { return points.data() + count; }
+	const Vec2 *begin() const { return points.data(); }
+	const Vec2 *end() const { return points.data() + count; }
+	// keep the points pred accepts, in order
+	template <typename Pred>
+	void keep_if(Pred &&pred) {
+		size_t kept = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (pred(points[i])) { points[kept++] = points[i]; }
+		}
+		count = kept;
+	}
+};
+
 namespace graphics {
-std::vector<Vec2> Line2_Line2_intersect(const Line2 &l1, const Line2 &l2);
-std::vector<Vec2> Line2_Circle2_intersect(const Line2 &l, const Circle2 &c);
-std::vector<Vec2> Circle2_Circle2_intersect(const Circle2 &c1, const Circle2 &c2);
-std::vector<Vec2> Arc2_Line2_intersect(const Arc2 &a, const Line2 &l);
-std::vector<Vec2> Arc2_Circle2_intersect(const Arc2 &a, const Circle2 &c);
-std::vector<Vec2> Arc2_Arc2_intersect(const Arc2 &a1, const Arc2 &a2);
+IxnPoints Line2_Line2_intersect(const Line2 &l1, const Line2 &l2);
+IxnPoints Line2_Circle2_intersect(const Line2 &l, const Circle2 &c);
+IxnPoints Circle2_Circle2_intersect(const Circle2 &c1, const Circle2 &c2);
+IxnPoints Arc2_Line2_intersect(const Arc2 &a, const Line2 &l);
+IxnPoints Arc2_Circle2_intersect(const Arc2 &a, const Circle2 &c);
+IxnPoints Arc2_Arc2_intersect(const Arc2 &a1, const Arc2 &a2);
 } // namespace graphics
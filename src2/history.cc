@@ -0,0 +1,174 @@
+#include "history.hpp"
+#include "nodes.hpp"
+#include "layers.hpp"
+
+namespace history {
+namespace detail {
+bool same_geometry(const ShapeValue &a, const ShapeValue &b) {
+	if (a.type != b.type) {
+		return false;
+	}
+	switch (a.type) {
+	case ShapeType::LINE:
+		return vec2::equal_epsilon(a.line.geom.A, b.line.geom.A) &&
+					 vec2::equal_epsilon(a.line.geom.B, b.line.geom.B) &&
+					 a.line.pflags.concealed == b.line.pflags.concealed;
+	case ShapeType::CIRCLE:
+		return vec2::equal_epsilon(a.circle.geom.C, b.circle.geom.C) &&
+					 vec2::equal_epsilon(a.circle.geom.P, b.circle.geom.P) &&
+					 a.circle.pflags.concealed == b.circle.pflags.concealed;
+	case ShapeType::ARC:
+		return vec2::equal_epsilon(a.arc.geom.C, b.arc.geom.C) &&
+					 vec2::equal_epsilon(a.arc.geom.S, b.arc.geom.S) &&
+					 vec2::equal_epsilon(a.arc.geom.E, b.arc.geom.E) &&
+					 a.arc.geom.clockwise == b.arc.geom.clockwise &&
+					 a.arc.pflags.concealed == b.arc.pflags.concealed;
+	default:
+		return false;
+	}
+}
+
+std::shared_ptr<const ShapeValue> share(History &history, const ShapeValue &value,
+																				const int id) {
+	auto &latest = history.latest[id];
+	if (!latest || !same_geometry(*latest, value)) {
+		latest = std::make_shared<const ShapeValue>(value);
+	}
+	return latest;
+}
+
+void push(History &history, const OpKind kind, const ShapeValue &value,
+					const int id) {
+	if (history.replaying) {
+		return;
+	}
+	history.pending.ops.push_back(Op{kind, id, share(history, value, id)});
+}
+
+void remove_by_id(Shapes &shapes, const int id) {
+	if (id < 0 || static_cast<size_t>(id) >= shapes.by_id.size()) {
+		return;
+	}
+	const ShapeSlot slot = shapes.by_id[id];
+	switch (slot.type) {
+	case ShapeType::LINE:   shapes::remove_line(shapes, slot.handle);   break;
+	case ShapeType::CIRCLE: shapes::remove_circle(shapes, slot.handle); break;
+	case ShapeType::ARC:    shapes::remove_arc(shapes, slot.handle);    break;
+	default: break;
+	}
+}
+
+void restore(Shapes &shapes, const ShapeValue &value) {
+	switch (value.type) {
+	case ShapeType::LINE:   shapes::add_line(shapes, value.line);     break;
+	case ShapeType::CIRCLE: shapes::add_circle(shapes, value.circle); break;
+	case ShapeType::ARC:    shapes::add_arc(shapes, value.arc);       break;
+	default: break;
+	}
+}
+
+// forward replays the op as recorded, backward applies its inverse
+void apply(Shapes &shapes, const Op &op, const bool forward) {
+	bool adds = (op.kind == OpKind::ADD) == forward;
+	if (op.kind == OpKind::CONCEAL) {
+		if (Shape *shape = nodes::detail::shape_by_id(shapes, op.id)) {
+			util::toggle_bool(shape->pflags.concealed);
+			layers::touch(shapes.layers, shape->pflags.layer);
+			nodes::refresh_concealed(shapes, op.id);
+		}
+	} else if (adds) {
+		if (!nodes::detail::shape_by_id(shapes, op.id)) {
+			restore(shapes, *op.value);
+			shapes.shape_tflags.selected.set(op.id, false);
+			nodes::insert_shape(shapes, op.id);
+		}
+	} else {
+		nodes::remove_shape(shapes, op.id);
+		remove_by_id(shapes, op.id);
+	}
+}
+
+template <typename Replay>
+void replay(Shapes &shapes, Replay &&replay_ops) {
+	History &history = shapes.history;
+	bool quantity_change = shapes.quantity_change;
+	history.replaying = true;
+	replay_ops();
+	history.replaying = false;
+	// nodes are already patched, only the grid has to follow. nodes of
+	// instance copies only come from the full rebuild
+	shapes.quantity_change = quantity_change || !shapes.instance_groups.empty();
+	shapes.grid.built = false;
+}
+} // namespace detail
+
+void record(History &history, const OpKind kind, const Line &line) {
+	detail::push(history, kind, ShapeValue{ShapeType::LINE, line, {}, {}}, line.id);
+}
+void record(History &history, const OpKind kind, const Circle &circle) {
+	detail::push(history, kind, ShapeValue{ShapeType::CIRCLE, {}, circle, {}},
+							 circle.id);
+}
+void record(History &history, const OpKind kind, const Arc &arc) {
+	detail::push(history, kind, ShapeValue{ShapeType::ARC, {}, {}, arc}, arc.id);
+}
+
+void commit(History &history) {
+	if (history.pending.ops.empty()) {
+		return;
+	}
+	history.undo.push_back(std::move(history.pending));
+	history.pending = Action{};
+	if (history.undo.size() > History::max_actions) {
+		history.undo.pop_front();
+	}
+	history.redo.clear();
+}
+
+void forget(History &history, const int id) {
+	auto &ops = history.pending.ops;
+	ops.erase(std::remove_if(ops.begin(), ops.end(),
+													 [id](const Op &op) { return op.id == id; }),
+						ops.end());
+}
+
+void clear(History &history) {
+	history.undo.clear();
+	history.redo.clear();
+	history.pending = Action{};
+	history.latest.clear();
+}
+
+bool undo(Shapes &shapes) {
+	History &history = shapes.history;
+	commit(history);
+	if (history.undo.empty()) {
+		return false;
+	}
+	Action action = std::move(history.undo.back());
+	history.undo.pop_back();
+	detail::replay(shapes, [&] {
+		for (auto iter = action.ops.rbegin(); iter != action.ops.rend(); iter++) {
+			detail::apply(shapes, *iter, false);
+		}
+	});
+	history.redo.push_back(std::move(action));
+	return true;
+}
+
+bool redo(Shapes &shapes) {
+	History &history = shapes.history;
+	if (history.redo.empty()) {
+		return false;
+	}
+	Action action = std::move(history.redo.back());
+	history.redo.pop_back();
+	detail::replay(shapes, [&] {
+		for (const auto &op : action.ops) {
+			detail::apply(shapes, op, true);
+		}
+	});
+	history.undo.push_back(std::move(action));
+	return true;
+}
+} // namespace history
@@ -0,0 +1,24 @@
+// history.hpp
+#pragma once
+#include "core.hpp"
+#include "shapes.hpp"
+
+namespace history {
+namespace detail {
+std::shared_ptr<const ShapeValue> share(History &history, const ShapeValue &value,
+																				const int id);
+void apply(Shapes &shapes, const Op &op, const bool forward);
+} // namespace detail
+// called by shapes::add_*, remove_* and toggle_concealed
+void record(History &history, const OpKind kind, const Line &line);
+void record(History &history, const OpKind kind, const Circle &circle);
+void record(History &history, const OpKind kind, const Arc &arc);
+// close the ops recorded since the last commit into one action
+void commit(History &history);
+// an edit was cancelled, its shape went back unchanged
+void forget(History &history, const int id);
+void clear(History &history);
+// nodes are patched per shape, no full nodes::rebuild is triggered
+bool undo(Shapes &shapes);
+bool redo(Shapes &shapes);
+} // namespace history
@@ -0,0 +1,210 @@
+#include "image.hpp"
+#include "arena.hpp"
+
+namespace image {
+namespace detail {
+uint32_t crc32(const uint8_t *data, size_t n, uint32_t crc) {
+	static uint32_t table[256] = {};
+	if (table[1] == 0) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < n; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+void put_u32_be(std::vector<uint8_t> &v, uint32_t x) {
+	v.push_back(x >> 24); v.push_back(x >> 16); v.push_back(x >> 8); v.push_back(x);
+}
+
+void write_png_chunk(ImageWriter &writer, const char *type,
+										 const uint8_t *data, size_t n) {
+	std::vector<uint8_t> head;
+	put_u32_be(head, static_cast<uint32_t>(n));
+	head.insert(head.end(), type, type + 4);
+	uint32_t crc = crc32(head.data() + 4, 4);
+	crc = crc32(data, n, crc);
+	writer.out.write(reinterpret_cast<const char *>(head.data()), head.size());
+	writer.out.write(reinterpret_cast<const char *>(data), n);
+	std::vector<uint8_t> tail;
+	put_u32_be(tail, crc);
+	writer.out.write(reinterpret_cast<const char *>(tail.data()), tail.size());
+}
+
+// deflate stored blocks (no compression), one row can span several blocks
+void append_stored(ImageWriter &writer, const uint8_t *data, size_t n,
+									 bool last_row) {
+	constexpr size_t block_max = 65535;
+	size_t pos = 0;
+	do {
+		size_t len = std::min(block_max, n - pos);
+		bool final = last_row && pos + len == n;
+		writer.buf.push_back(final ? 1 : 0);
+		writer.buf.push_back(len & 0xFF);
+		writer.buf.push_back(len >> 8);
+		writer.buf.push_back(~len & 0xFF);
+		writer.buf.push_back((~len >> 8) & 0xFF);
+		writer.buf.insert(writer.buf.end(), data + pos, data + pos + len);
+		pos += len;
+	} while (pos < n);
+	// adler32 over the uncompressed stream
+	for (size_t i = 0; i < n; i++) {
+		writer.adler_a = (writer.adler_a + data[i]) % 65521;
+		writer.adler_b = (writer.adler_b + writer.adler_a) % 65521;
+	}
+}
+} // namespace detail
+
+ImageFormat format_from_path(const std::string &path) {
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0) {
+		return ImageFormat::PPM;
+	}
+	return ImageFormat::PNG;
+}
+
+bool begin(ImageWriter &writer, const std::string &path, ImageFormat format,
+					 int width, int height) {
+	writer.out.open(path, std::ios::binary);
+	if (!writer.out) {
+		return false;
+	}
+	writer.format = format;
+	writer.width = width;
+	writer.height = height;
+	writer.rows_written = 0;
+	writer.adler_a = 1;
+	writer.adler_b = 0;
+	if (format == ImageFormat::PPM) {
+		writer.out << "P6\n" << width << " " << height << "\n255\n";
+	} else {
+		const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		writer.out.write(reinterpret_cast<const char *>(signature), 8);
+		std::vector<uint8_t> ihdr;
+		detail::put_u32_be(ihdr, width);
+		detail::put_u32_be(ihdr, height);
+		// 8 bit depth, truecolor rgb, deflate, adaptive filter, no interlace
+		ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0});
+		detail::write_png_chunk(writer, "IHDR", ihdr.data(), ihdr.size());
+	}
+	return true;
+}
+
+void write_rows(ImageWriter &writer, const uint32_t *pixels, int rows) {
+	std::vector<uint8_t> row;
+	row.reserve(1 + 3 * writer.width);
+	writer.buf.clear();
+	if (writer.format == ImageFormat::PNG && writer.rows_written == 0) {
+		// zlib header, deflate with 32k window, no preset dictionary
+		writer.buf.push_back(0x78);
+		writer.buf.push_back(0x01);
+	}
+	for (int y = 0; y < rows; y++) {
+		row.clear();
+		if (writer.format == ImageFormat::PNG) {
+			row.push_back(0); // filter type none
+		}
+		const uint32_t *src = pixels + static_cast<size_t>(y) * writer.width;
+		for (int x = 0; x < writer.width; x++) {
+			row.push_back((src[x] >> 16) & 0xFF);
+			row.push_back((src[x] >> 8) & 0xFF);
+			row.push_back(src[x] & 0xFF);
+		}
+		writer.rows_written++;
+		if (writer.format == ImageFormat::PPM) {
+			writer.out.write(reinterpret_cast<const char *>(row.data()), row.size());
+		} else {
+			detail::append_stored(writer, row.data(), row.size(),
+														writer.rows_written == writer.height);
+		}
+	}
+	if (writer.format == ImageFormat::PNG) {
+		if (writer.rows_written == writer.height) {
+			detail::put_u32_be(writer.buf, (writer.adler_b << 16) | writer.adler_a);
+		}
+		detail::write_png_chunk(writer, "IDAT", writer.buf.data(), writer.buf.size());
+	}
+}
+
+bool finish(ImageWriter &writer) {
+	assert(writer.rows_written == writer.height);
+	if (writer.format == ImageFormat::PNG) {
+		detail::write_png_chunk(writer, "IEND", nullptr, 0);
+	}
+	writer.out.close();
+	return !writer.out.fail();
+}
+
+bool write_image(const std::string &path, const uint32_t *pixels,
+								 int width, int height) {
+	ImageWriter writer;
+	if (!begin(writer, path, format_from_path(path), width, height)) {
+		return false;
+	}
+	write_rows(writer, pixels, height);
+	return finish(writer);
+}
+
+void fit_scene(ExportSettings &settings, const Shapes &shapes) {
+	double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+	double max_x = std::numeric_limits<double>::lowest(), max_y = max_x;
+	auto extend = [&](const Vec2 &P, double r) {
+		min_x = std::min(min_x, P.x - r); max_x = std::max(max_x, P.x + r);
+		min_y = std::min(min_y, P.y - r); max_y = std::max(max_y, P.y + r);
+	};
+	for (const auto &line : shapes.lines) {
+		extend(line.geom.A, 0.0);
+		extend(line.geom.B, 0.0);
+	}
+	for (const auto &circle : shapes.circles) {
+		extend(circle.geom.C, circle.geom.radius());
+	}
+	for (const auto &arc : shapes.arcs) {
+		extend(arc.geom.C, arc.geom.radius());
+	}
+	if (min_x > max_x) {
+		settings.origin = {};
+		settings.scale = 1.0;
+		return;
+	}
+	// 5% margin on each side
+	double w = std::max(max_x - min_x, 1.0);
+	double h = std::max(max_y - min_y, 1.0);
+	settings.scale = std::min(settings.width / (w * 1.1), settings.height / (h * 1.1));
+	Vec2 center{(min_x + max_x) / 2.0, (min_y + max_y) / 2.0};
+	settings.origin = center - Vec2{settings.width / 2.0, settings.height / 2.0} *
+		(1.0 / settings.scale);
+}
+
+bool export_scene(const Shapes &shapes, const std::string &path,
+									const ExportSettings &settings) {
+	assert(settings.width > 0 && settings.height > 0 && settings.tile_rows > 0);
+	ImageWriter writer;
+	if (!begin(writer, path, settings.format, settings.width, settings.height)) {
+		std::cerr << "couldn't open " << path << std::endl;
+		return false;
+	}
+	int tile_rows = std::min(settings.tile_rows, settings.height);
+	std::vector<uint32_t> tile(static_cast<size_t>(settings.width) * tile_rows);
+	for (int y0 = 0; y0 < settings.height; y0 += tile_rows) {
+		int rows = std::min(tile_rows, settings.height - y0);
+		// the tile is a canvas whose origin is shifted down by y0 image rows
+		Canvas canvas{tile.data(), settings.width, rows,
+			settings.origin + Vec2{0.0, y0 / settings.scale}, settings.scale,
+			settings.mode};
+		std::fill_n(canvas.pixels, canvas.width * canvas.height, draw::bg_color);
+		draw::render_scene(canvas, shapes);
+		write_rows(writer, canvas.pixels, rows);
+		// render_scene takes its culling and instance scratch from there
+		arena::reset_frame();
+	}
+	return finish(writer);
+}
+} // namespace image
@@ -0,0 +1,58 @@
+// image.hpp
+#pragma once
+#include "core.hpp"
+#include "graphics.hpp"
+#include "shapes.hpp"
+#include "draw.hpp"
+
+// headless rendering into plain buffers, no SDL video needed
+enum struct ImageFormat { PPM, PNG };
+
+struct ExportSettings {
+	int width = 1920;
+	int height = 1080;
+	// world to image transform, see Canvas
+	Vec2 origin{};
+	double scale = 1.0;
+	// rows rendered per pass, memory is width * tile_rows * 4 bytes
+	int tile_rows = 256;
+	ImageFormat format = ImageFormat::PNG;
+	RenderMode mode = RenderMode::ALIASED;
+};
+
+// streams rows of a xrgb buffer into a ppm or png file
+struct ImageWriter {
+	std::ofstream out;
+	ImageFormat format = ImageFormat::PNG;
+	int width = 0;
+	int height = 0;
+	int rows_written = 0;
+	uint32_t adler_a = 1;
+	uint32_t adler_b = 0;
+	std::vector<uint8_t> buf;
+};
+
+namespace image {
+namespace detail {
+uint32_t crc32(const uint8_t *data, size_t n, uint32_t crc = 0);
+void write_png_chunk(ImageWriter &writer, const char *type,
+										 const uint8_t *data, size_t n);
+} // namespace detail
+ImageFormat format_from_path(const std::string &path);
+
+bool begin(ImageWriter &writer, const std::string &path, ImageFormat format,
+					 int width, int height);
+void write_rows(ImageWriter &writer, const uint32_t *pixels, int rows);
+bool finish(ImageWriter &writer);
+
+bool write_image(const std::string &path, const uint32_t *pixels,
+								 int width, int height);
+
+// fit origin and scale so all shapes are visible with some margin
+void fit_scene(ExportSettings &settings, const Shapes &shapes);
+// render in horizontal tiles of tile_rows, memory stays bounded. the
+// frame arena is rewound after every tile, nothing from it may be alive
+// across the call
+bool export_scene(const Shapes &shapes, const std::string &path,
+									const ExportSettings &settings);
+} // namespace image
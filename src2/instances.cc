@@ -0,0 +1,430 @@
+#include "instances.hpp"
+#include "geometry.hpp"
+#include "layers.hpp"
+
+namespace instances {
+namespace detail {
+Vec2 apply(const Isometry &T, const Vec2 &P) {
+	return Vec2{T.m00 * P.x + T.m01 * P.y + T.t.x,
+							T.m10 * P.x + T.m11 * P.y + T.t.y};
+}
+
+Isometry compose(const Isometry &a, const Isometry &b) {
+	Isometry T;
+	T.m00 = a.m00 * b.m00 + a.m01 * b.m10;
+	T.m01 = a.m00 * b.m01 + a.m01 * b.m11;
+	T.m10 = a.m10 * b.m00 + a.m11 * b.m10;
+	T.m11 = a.m10 * b.m01 + a.m11 * b.m11;
+	T.t = apply(a, b.t);
+	return T;
+}
+
+void set_inverse(InstanceGroup &group) {
+	auto is_identity = [](const Isometry &T) {
+		return std::abs(T.m00 - 1.0) < gk::epsilon && std::abs(T.m01) < gk::epsilon &&
+					 std::abs(T.m10) < gk::epsilon && std::abs(T.m11 - 1.0) < gk::epsilon &&
+					 vec2::equal_epsilon(T.t, Vec2{});
+	};
+	size_t n = group.transforms.size();
+	group.inverse.assign(n, 0);
+	for (size_t k = 0; k < n; k++) {
+		for (size_t j = 0; j < n; j++) {
+			if (is_identity(compose(group.transforms[j], group.transforms[k]))) {
+				group.inverse[k] = static_cast<uint32_t>(j);
+				break;
+			}
+		}
+	}
+}
+
+bool make_instance(const Shapes &shapes, const InstanceGroup &group,
+									 const uint32_t group_index, const int base_id,
+									 const uint32_t transform, Instance &out) {
+	if (base_id < 0 || static_cast<size_t>(base_id) >= shapes.by_id.size()) {
+		return false;
+	}
+	const ShapeSlot &slot = shapes.by_id[base_id];
+	const Isometry &T = group.transforms[transform];
+	out = Instance{};
+	out.type = slot.type;
+	out.base_id = base_id;
+	out.group = group_index;
+	out.transform = transform;
+	switch (slot.type) {
+	case ShapeType::LINE: {
+		const Line *line = shapes.lines.get(slot.handle);
+		if (!line) { return false; }
+		out.concealed = line->pflags.concealed;
+		out.layer = line->pflags.layer;
+		out.line = Line2{apply(T, line->geom.A), apply(T, line->geom.B)};
+		return true;
+	}
+	case ShapeType::CIRCLE: {
+		const Circle *circle = shapes.circles.get(slot.handle);
+		if (!circle) { return false; }
+		out.concealed = circle->pflags.concealed;
+		out.layer = circle->pflags.layer;
+		out.circle = Circle2{apply(T, circle->geom.C), apply(T, circle->geom.P)};
+		return true;
+	}
+	case ShapeType::ARC: {
+		const Arc *arc = shapes.arcs.get(slot.handle);
+		if (!arc) { return false; }
+		out.concealed = arc->pflags.concealed;
+		out.layer = arc->pflags.layer;
+		out.arc = Arc2{apply(T, arc->geom.C), apply(T, arc->geom.S),
+									 apply(T, arc->geom.E)};
+		// a mirror turns the arc around
+		out.arc.clockwise = T.mirrors() ? !arc->geom.clockwise : arc->geom.clockwise;
+		out.arc.S_angle = circle2::get_angle_of_point(out.arc.to_circle(), out.arc.S);
+		out.arc.E_angle = circle2::get_angle_of_point(out.arc.to_circle(), out.arc.E);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+// ShapeType orders LINE < CIRCLE < ARC
+IxnPoints intersect(const Instance &a, const Instance &b) {
+	if (a.type > b.type) {
+		return intersect(b, a);
+	}
+	if (a.type == ShapeType::LINE) {
+		switch (b.type) {
+		case ShapeType::LINE:   return graphics::Line2_Line2_intersect(a.line, b.line);
+		case ShapeType::CIRCLE: return graphics::Line2_Circle2_intersect(a.line, b.circle);
+		case ShapeType::ARC:    return graphics::Arc2_Line2_intersect(b.arc, a.line);
+		default: return {};
+		}
+	} else if (a.type == ShapeType::CIRCLE) {
+		switch (b.type) {
+		case ShapeType::CIRCLE: return graphics::Circle2_Circle2_intersect(a.circle, b.circle);
+		case ShapeType::ARC:    return graphics::Arc2_Circle2_intersect(b.arc, a.circle);
+		default: return {};
+		}
+	} else if (a.type == ShapeType::ARC && b.type == ShapeType::ARC) {
+		return graphics::Arc2_Arc2_intersect(a.arc, b.arc);
+	}
+	return {};
+}
+
+bool near(const Layers &layers, const Instance &a, const Instance &b) {
+	if (!layers::intersects(layers, a.layer, b.layer)) {
+		return false;
+	}
+	Box box = bounds(a);
+	Vec2 margin{geometry::candidate_margin, geometry::candidate_margin};
+	return spatial::overlap(Box{box.min - margin, box.max + margin}, bounds(b));
+}
+
+void append_ixn(Shapes &shapes, Vec2 P, const int id_a, const int id_b,
+								const bool concealed) {
+	if (id_a < 0 && id_b < 0) {
+		shapes::maybe_append_node(shapes.ixn_points, P, -1, concealed);
+		return;
+	}
+	if (id_a >= 0) {
+		shapes::maybe_append_node(shapes.ixn_points, P, id_a, concealed);
+	}
+	if (id_b >= 0) {
+		shapes::maybe_append_node(shapes.ixn_points, P, id_b, concealed);
+	}
+}
+
+void append_def_points(Shapes &shapes, const Instance &copy) {
+	std::array<Vec2, 3> points{};
+	size_t n = 0;
+	switch (copy.type) {
+	case ShapeType::LINE:
+		points = {copy.line.A, copy.line.B};
+		n = 2;
+		break;
+	case ShapeType::CIRCLE:
+		points = {copy.circle.C};
+		n = 1;
+		break;
+	case ShapeType::ARC:
+		points = {copy.arc.C, copy.arc.S, copy.arc.E};
+		n = 3;
+		break;
+	default:
+		break;
+	}
+	for (size_t i = 0; i < n; i++) {
+		shapes::maybe_append_node(shapes.def_points, points[i], -1, copy.concealed);
+	}
+}
+
+std::vector<int> selected_ids(const Shapes &shapes) {
+	std::vector<int> ids;
+	auto collect = [&](const auto &store) {
+		for (const auto &shape : store) {
+			if (shapes.shape_tflags.selected.test(shape.id)) {
+				ids.push_back(shape.id);
+			}
+		}
+	};
+	collect(shapes.lines);
+	collect(shapes.circles);
+	collect(shapes.arcs);
+	return ids;
+}
+} // namespace detail
+
+InstanceGroup rotation(std::vector<int> base_ids, const Vec2 &pivot,
+											 const int fold) {
+	InstanceGroup group;
+	group.kind = InstanceKind::ROTATION;
+	group.base_ids = std::move(base_ids);
+	group.pivot = pivot;
+	group.fold = std::max(fold, 2);
+	for (int k = 0; k < group.fold; k++) {
+		double angle = 2.0 * std::numbers::pi * k / group.fold;
+		Isometry T;
+		T.m00 = std::cos(angle);
+		T.m01 = -std::sin(angle);
+		T.m10 = std::sin(angle);
+		T.m11 = std::cos(angle);
+		T.t = pivot - Vec2{T.m00 * pivot.x + T.m01 * pivot.y,
+											 T.m10 * pivot.x + T.m11 * pivot.y};
+		group.transforms.push_back(T);
+	}
+	detail::set_inverse(group);
+	return group;
+}
+
+InstanceGroup mirror(std::vector<int> base_ids, const Line2 &axis) {
+	InstanceGroup group;
+	group.kind = InstanceKind::MIRROR;
+	group.base_ids = std::move(base_ids);
+	group.axis = axis;
+	// reflection about the axis direction d is 2 d d^T - I
+	Vec2 d = axis.direction();
+	Isometry T;
+	T.m00 = 2.0 * d.x * d.x - 1.0;
+	T.m01 = 2.0 * d.x * d.y;
+	T.m10 = 2.0 * d.x * d.y;
+	T.m11 = 2.0 * d.y * d.y - 1.0;
+	T.t = axis.A - Vec2{T.m00 * axis.A.x + T.m01 * axis.A.y,
+											T.m10 * axis.A.x + T.m11 * axis.A.y};
+	group.transforms = {Isometry{}, T};
+	detail::set_inverse(group);
+	return group;
+}
+
+void add_group(Shapes &shapes, InstanceGroup group) {
+	shapes.instance_groups.push_back(std::move(group));
+	shapes.quantity_change = true;
+}
+
+void pop_group(Shapes &shapes) {
+	if (!shapes.instance_groups.empty()) {
+		shapes.instance_groups.pop_back();
+		shapes.quantity_change = true;
+	}
+}
+
+void rotate_selected(Shapes &shapes) {
+	const Snap &snap = shapes.snap;
+	if (!snap.in_distance || !snap.is_node_shape) {
+		cout << "rotation needs a node under the cursor" << endl;
+		return;
+	}
+	std::vector<int> ids = detail::selected_ids(shapes);
+	if (ids.empty()) {
+		return;
+	}
+	add_group(shapes, rotation(std::move(ids), snap.point,
+														 InstanceGroup::default_fold));
+	shapes.shape_tflags.selected.clear();
+}
+
+void mirror_selected(Shapes &shapes) {
+	const Line *axis = shapes.ref.shape == RefShape::LINE ?
+		shapes.get_line_by_id(shapes.ref.id) : nullptr;
+	if (!axis || axis->geom.length() < gk::epsilon) {
+		cout << "mirror needs a reference line" << endl;
+		return;
+	}
+	std::vector<int> ids = detail::selected_ids(shapes);
+	if (ids.empty()) {
+		return;
+	}
+	add_group(shapes, mirror(std::move(ids), axis->geom));
+	shapes.shape_tflags.selected.clear();
+}
+
+void expand(const Shapes &shapes, std::pmr::vector<Instance> &out) {
+	for (size_t g = 0; g < shapes.instance_groups.size(); g++) {
+		const InstanceGroup &group = shapes.instance_groups[g];
+		for (int id : group.base_ids) {
+			for (size_t k = 1; k < group.transforms.size(); k++) {
+				Instance copy;
+				if (detail::make_instance(shapes, group, static_cast<uint32_t>(g), id,
+																	static_cast<uint32_t>(k), copy)) {
+					out.push_back(copy);
+				}
+			}
+		}
+	}
+}
+
+Box bounds(const Instance &copy) {
+	switch (copy.type) {
+	case ShapeType::LINE:   return spatial::bounds(copy.line);
+	case ShapeType::CIRCLE: return spatial::bounds(copy.circle);
+	case ShapeType::ARC:    return spatial::bounds(copy.arc);
+	default: return Box{};
+	}
+}
+
+// same rules as update_snap for stored shapes
+bool snap_point(const Instance &copy, const Vec2 &P, const double distance,
+								Vec2 &point) {
+	switch (copy.type) {
+	case ShapeType::LINE: {
+		const Line2 &line = copy.line;
+		if (line2::get_distance_point_to_seg(line, P) >= distance) {
+			return false;
+		}
+		Vec2 projected_point = line2::project_point(line, P);
+		if (line2::point_in_segment_bounds(line, projected_point)) {
+			point = projected_point;
+		} else if (vec2::distance(P, line.A) < distance) {
+			point = line.A;
+		} else if (vec2::distance(P, line.B) < distance) {
+			point = line.B;
+		} else {
+			return false;
+		}
+		return true;
+	}
+	case ShapeType::CIRCLE: {
+		double center_distance = vec2::distance(copy.circle.C, P);
+		double r = copy.circle.radius();
+		if (center_distance < r + distance && center_distance > r - distance) {
+			point = circle2::project_point(copy.circle, P);
+			return true;
+		}
+		return false;
+	}
+	case ShapeType::ARC: {
+		double center_distance = vec2::distance(copy.arc.C, P);
+		double r = copy.arc.radius();
+		if (center_distance < r + distance && center_distance > r - distance &&
+				arc2::angle_on_arc(copy.arc, circle2::get_angle_of_point(
+					copy.arc.to_circle(), P))) {
+			point = circle2::project_point(copy.arc.to_circle(), P);
+			return true;
+		}
+		return false;
+	}
+	default:
+		return false;
+	}
+}
+
+// b1 meets T_h b2 in P, so T_g b1 meets T_g T_h b2 in T_g P. pairs inside
+// a group are intersected once per h and the points are replicated over g,
+// a point is on a stored shape where g or g T_h is the identity
+void append_nodes(Shapes &shapes) {
+	const std::vector<InstanceGroup> &groups = shapes.instance_groups;
+	if (groups.empty()) {
+		return;
+	}
+	// stored shapes as identity copies
+	std::vector<Instance> stored;
+	for (const auto &line : shapes.lines) {
+		Instance s{ShapeType::LINE, line.id, 0, 0, line.pflags.concealed,
+							 line.pflags.layer, line.geom, {}, {}};
+		stored.push_back(s);
+	}
+	for (const auto &circle : shapes.circles) {
+		Instance s{ShapeType::CIRCLE, circle.id, 0, 0, circle.pflags.concealed,
+							 circle.pflags.layer, {}, circle.geom, {}};
+		stored.push_back(s);
+	}
+	for (const auto &arc : shapes.arcs) {
+		Instance s{ShapeType::ARC, arc.id, 0, 0, arc.pflags.concealed,
+							 arc.pflags.layer, {}, {}, arc.geom};
+		stored.push_back(s);
+	}
+
+	// per group every live base shape under every transform, base-major
+	std::vector<std::vector<Instance>> copies(groups.size());
+	for (size_t gi = 0; gi < groups.size(); gi++) {
+		const InstanceGroup &group = groups[gi];
+		const size_t n = group.transforms.size();
+		std::vector<Instance> &own = copies[gi];
+		for (int id : group.base_ids) {
+			Instance copy;
+			if (!detail::make_instance(shapes, group, static_cast<uint32_t>(gi), id, 0,
+																 copy)) {
+				continue;
+			}
+			own.push_back(copy);
+			for (size_t k = 1; k < n; k++) {
+				detail::make_instance(shapes, group, static_cast<uint32_t>(gi), id,
+															static_cast<uint32_t>(k), copy);
+				own.push_back(copy);
+			}
+		}
+		const size_t n_base = own.size() / n;
+
+		// orbits inside the group, identity against identity is a pair of
+		// stored shapes and nodes::rebuild has it already
+		for (size_t h = 0; h < n; h++) {
+			for (size_t i = 0; i < n_base; i++) {
+				for (size_t j = 0; j < n_base; j++) {
+					if (h == 0 && j <= i) { continue; }
+					const Instance &a = own[i * n];
+					const Instance &b = own[j * n + h];
+					if (!detail::near(shapes.layers, a, b)) { continue; }
+					bool concealed = a.concealed || b.concealed;
+					for (const Vec2 &P : detail::intersect(a, b)) {
+						for (size_t g = 0; g < n; g++) {
+							if (h == 0 && g == 0) { continue; }
+							detail::append_ixn(shapes, detail::apply(group.transforms[g], P),
+																 g == 0 ? a.base_id : -1,
+																 g == group.inverse[h] ? b.base_id : -1,
+																 concealed);
+						}
+					}
+				}
+			}
+		}
+
+		// copies against the stored shapes outside the group
+		for (const Instance &copy : own) {
+			if (copy.transform == 0) { continue; }
+			for (const Instance &s : stored) {
+				if (shapes::id_match(group.base_ids, s.base_id) ||
+						!detail::near(shapes.layers, copy, s)) {
+					continue;
+				}
+				for (const Vec2 &P : detail::intersect(copy, s)) {
+					detail::append_ixn(shapes, P, -1, s.base_id,
+														 copy.concealed || s.concealed);
+				}
+			}
+			detail::append_def_points(shapes, copy);
+		}
+	}
+
+	// copies of different groups
+	for (size_t gi = 0; gi < groups.size(); gi++) {
+		for (size_t gj = gi + 1; gj < groups.size(); gj++) {
+			for (const Instance &a : copies[gi]) {
+				if (a.transform == 0) { continue; }
+				for (const Instance &b : copies[gj]) {
+					if (b.transform == 0 || !detail::near(shapes.layers, a, b)) { continue; }
+					for (const Vec2 &P : detail::intersect(a, b)) {
+						detail::append_ixn(shapes, P, -1, -1, a.concealed || b.concealed);
+					}
+				}
+			}
+		}
+	}
+}
+} // namespace instances
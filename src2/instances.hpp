@@ -0,0 +1,58 @@
+// instances.hpp
+#pragma once
+#include "core.hpp"
+#include "graphics.hpp"
+#include "shapes.hpp"
+#include "spatial.hpp"
+
+// one transformed copy of a base shape, built when needed and never stored
+struct Instance {
+	ShapeType type = ShapeType::NONE;
+	int base_id {-1};
+	uint32_t group = 0;
+	uint32_t transform = 0;
+	bool concealed = false;
+	uint8_t layer = 0;
+	Line2 line{};
+	Circle2 circle{};
+	Arc2 arc{};
+};
+
+namespace instances {
+namespace detail {
+Vec2 apply(const Isometry &T, const Vec2 &P);
+// first b, then a
+Isometry compose(const Isometry &a, const Isometry &b);
+void set_inverse(InstanceGroup &group);
+// the base shape under one transform of the group, false if it is gone
+bool make_instance(const Shapes &shapes, const InstanceGroup &group,
+									 const uint32_t group_index, const int base_id,
+									 const uint32_t transform, Instance &out);
+IxnPoints intersect(const Instance &a, const Instance &b);
+// layers intersect and bounds are close enough for an exact test
+bool near(const Layers &layers, const Instance &a, const Instance &b);
+// a point on copies only is kept as a node without ids
+void append_ixn(Shapes &shapes, Vec2 P, const int id_a, const int id_b,
+								const bool concealed);
+void append_def_points(Shapes &shapes, const Instance &copy);
+std::vector<int> selected_ids(const Shapes &shapes);
+} // namespace detail
+InstanceGroup rotation(std::vector<int> base_ids, const Vec2 &pivot,
+											 const int fold);
+InstanceGroup mirror(std::vector<int> base_ids, const Line2 &axis);
+
+// groups are not part of the undo history
+void add_group(Shapes &shapes, InstanceGroup group);
+void pop_group(Shapes &shapes);
+// the selection about the snapped node or across the reference line
+void rotate_selected(Shapes &shapes);
+void mirror_selected(Shapes &shapes);
+
+// every copy of a live base shape except the identity
+void expand(const Shapes &shapes, std::pmr::vector<Instance> &out);
+Box bounds(const Instance &copy);
+bool snap_point(const Instance &copy, const Vec2 &P, const double distance,
+								Vec2 &point);
+// nodes of the copies, nodes::rebuild calls this after the stored shapes
+void append_nodes(Shapes &shapes);
+} // namespace instances
@@ -0,0 +1,97 @@
+#include "layers.hpp"
+
+namespace layers {
+bool intersects(const Layers &layers, const uint8_t a, const uint8_t b) {
+	return a < Layers::max_layers && b < Layers::max_layers &&
+				 (layers.intersects[a] >> b) & 1;
+}
+
+bool visible(const Layers &layers, const uint8_t layer) {
+	return layer >= layers.layers.size() || layers.layers[layer].visible;
+}
+
+bool frozen(const Layers &layers, const uint8_t layer) {
+	return layer < layers.layers.size() && layers.layers[layer].frozen;
+}
+
+bool nodes_cached(const Layers &layers, const uint8_t layer) {
+	if (!frozen(layers, layer)) {
+		return false;
+	}
+	const Layer &l = layers.layers[layer];
+	return l.nodes_cached && l.nodes_revision == l.revision;
+}
+
+void touch(Layers &layers, const uint8_t layer) {
+	if (layer < layers.layers.size()) {
+		layers.layers[layer].revision++;
+	}
+}
+
+bool add(Shapes &shapes) {
+	Layers &layers = shapes.layers;
+	if (layers.layers.size() >= Layers::max_layers) {
+		return false;
+	}
+	layers.layers.push_back(Layer{});
+	layers.active = static_cast<uint8_t>(layers.layers.size() - 1);
+	return true;
+}
+
+void next_active(Shapes &shapes) {
+	Layers &layers = shapes.layers;
+	layers.active = static_cast<uint8_t>((layers.active + 1) % layers.layers.size());
+}
+
+void toggle_visible(Shapes &shapes, const uint8_t layer) {
+	if (layer < shapes.layers.layers.size()) {
+		util::toggle_bool(shapes.layers.layers[layer].visible);
+	}
+}
+
+// nodes stay valid, the cache is filled by the next rebuild
+void toggle_frozen(Shapes &shapes, const uint8_t layer) {
+	if (layer < shapes.layers.layers.size()) {
+		Layer &l = shapes.layers.layers[layer];
+		util::toggle_bool(l.frozen);
+		l.nodes_cached = false;
+		l.node_records.clear();
+	}
+}
+
+void toggle_isolated(Shapes &shapes, const uint8_t layer) {
+	Layers &layers = shapes.layers;
+	if (layer >= Layers::max_layers) {
+		return;
+	}
+	uint16_t others = static_cast<uint16_t>(~(1u << layer));
+	bool isolated = (layers.intersects[layer] & others) == 0;
+	for (size_t j = 0; j < Layers::max_layers; j++) {
+		if (j == layer) { continue; }
+		uint16_t bit_j = static_cast<uint16_t>(1u << j);
+		uint16_t bit_layer = static_cast<uint16_t>(1u << layer);
+		if (isolated) {
+			layers.intersects[layer] |= bit_j;
+			layers.intersects[j] |= bit_layer;
+		} else {
+			layers.intersects[layer] &= static_cast<uint16_t>(~bit_j);
+			layers.intersects[j] &= static_cast<uint16_t>(~bit_layer);
+		}
+	}
+	shapes.quantity_change = true;
+}
+
+void clear(Layers &layers) {
+	layers = Layers{};
+}
+
+void print(const Layers &layers) {
+	for (size_t i = 0; i < layers.layers.size(); i++) {
+		const Layer &l = layers.layers[i];
+		cout << "layer " << i << (i == layers.active ? " (active)" : "")
+			<< (l.visible ? "" : " hidden") << (l.frozen ? " frozen" : "")
+			<< " intersects: " << std::bitset<Layers::max_layers>(layers.intersects[i])
+			<< endl;
+	}
+}
+} // namespace layers
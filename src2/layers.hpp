@@ -0,0 +1,25 @@
+// layers.hpp
+#pragma once
+#include "core.hpp"
+#include "shapes.hpp"
+
+namespace layers {
+bool intersects(const Layers &layers, const uint8_t a, const uint8_t b);
+bool visible(const Layers &layers, const uint8_t layer);
+bool frozen(const Layers &layers, const uint8_t layer);
+// the cached nodes of a frozen layer still match its shapes
+bool nodes_cached(const Layers &layers, const uint8_t layer);
+// a shape of the layer was added, removed or changed
+void touch(Layers &layers, const uint8_t layer);
+
+// appends a layer that intersects every other and makes it active,
+// false if there are max_layers already
+bool add(Shapes &shapes);
+void next_active(Shapes &shapes);
+void toggle_visible(Shapes &shapes, const uint8_t layer);
+void toggle_frozen(Shapes &shapes, const uint8_t layer);
+// cuts the layer off from every other layer or connects it again
+void toggle_isolated(Shapes &shapes, const uint8_t layer);
+void clear(Layers &layers);
+void print(const Layers &layers);
+} // namespace layers
@@ -5,17 +5,30 @@
 #include "shapes.hpp"
 #include "gen.hpp"
 #include "serialize.hpp"
+#include "image.hpp"
+#include "spatial.hpp"
+#include "history.hpp"
+#include "arena.hpp"
+#include "nodes.hpp"
+#include "instances.hpp"
+#include "layers.hpp"
+#include "relstream.hpp"
+#include "atlas.hpp"
+#include "graph.hpp"
+#include "batch.hpp"
 
 constexpr const int gk_window_width = 1920/2;
 constexpr int gk_window_height = 1080/2;
+constexpr const char *gk_profile_file = "profile.csv";
 
 int app_init(App &app);
+int export_headless(int argc, char *argv[]);
+int relations_to_text(int argc, char *argv[]);
 
 // info
 void mode_change_cleanup(App &app, Shapes &shapes, GenShapes &gen_shapes);
-void process_events(App &app, Shapes &shapes, GenShapes &gen_shapes);
-
-void update_nodes(Shapes &shapes);
+void process_events(App &app, Shapes &shapes, GenShapes &gen_shapes,
+										RelationDiff &relation_diff);
 
 void check_for_changes(App &app, Shapes &shapes);
 
@@ -38,32 +51,74 @@ void print_info(App &app, Shapes &shapes) {
 	}
 	std::cout << "Snap ID: " << shapes.snap.id << std::endl;
 
+	if (profile::has_samples(app.profiler)) {
+		cout << "stage: min / avg / p99 ms" << endl;
+		for (size_t i = 0; i < frame_stage_count; i++) {
+			StageStats s = profile::stats(app.profiler, static_cast<FrameStage>(i));
+			cout << profile::stage_name(static_cast<FrameStage>(i)) << ": "
+				<< s.min_ms << " / " << s.avg_ms << " / " << s.p99_ms << endl;
+		}
+	}
+	layers::print(shapes.layers);
+	const FrameAllocations &allocs = app.profiler.allocations;
+	if (allocs.frames > 0) {
+		cout << "heap allocations per frame: " << allocs.last << " last / "
+			<< allocs.total / allocs.frames << " avg / " << allocs.max << " max" << endl;
+		cout << "frame arena: " << arena::frame_block_size() << " bytes" << endl;
+	}
+
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+	if (argc > 1 && std::string{argv[1]} == "--export") {
+		return export_headless(argc, argv);
+	}
+	if (argc > 1 && std::string{argv[1]} == "--relations-to-text") {
+		return relations_to_text(argc, argv);
+	}
+	if (argc > 1 && std::string{argv[1]} == "--batch") {
+		return batch::run(argc, argv);
+	}
 	App app;
 	Shapes shapes;
 	GenShapes gen_shapes;
+	RelationDiff relation_diff;
+	RelationFeed relation_feed;
 	if (!app_init(app)) {
 		return 1;
 	}
+	if (relfeed::open(relation_feed)) {
+		gen_shapes.feed = &relation_feed;
+	} else {
+		std::cerr << "relation feed not available" << std::endl;
+	}
 	while(app.context.keep_running) {
+		profile::begin(app.profiler, FrameStage::FRAME);
 		reset_frame_state(app);
+		profile::begin(app.profiler, FrameStage::SNAP);
 		shapes.snap.in_distance = shapes::update_snap(app, shapes);
+		profile::end(app.profiler, FrameStage::SNAP);
 
-		process_events(app, shapes, gen_shapes);
+		profile::begin(app.profiler, FrameStage::EVENTS);
+		process_events(app, shapes, gen_shapes, relation_diff);
+		profile::end(app.profiler, FrameStage::EVENTS);
 
 		// update node points
 		if (shapes.recalculate) {
-			update_nodes(shapes);
+			profile::begin(app.profiler, FrameStage::NODES);
+			nodes::rebuild(shapes);
+			profile::end(app.profiler, FrameStage::NODES);
 		}
+		gen::update_diff(shapes, relation_diff);
 
 		// update construction
+		profile::begin(app.profiler, FrameStage::CONSTRUCT);
 		if (shapes.snap.in_distance) {
 			shapes::construct(app, shapes, shapes.snap.point);
 		} else {
 			shapes::construct(app, shapes, app.input.mouse);
 		}
+		profile::end(app.profiler, FrameStage::CONSTRUCT);
 
 		switch (app.context.mode) {
 			case AppMode::NORMAL:
@@ -89,14 +144,23 @@ int main() {
 				if (shapes.snap.in_distance && app.input.mouse_click) {
 					gen::maybe_select(shapes, gen_shapes);
 				}
+				gen::update_preview(shapes, gen_shapes);
 				break;
 		}
 
-		draw::plot_shapes(app, shapes);
+		draw::plot_shapes(app, shapes, gen_shapes);
 		check_for_changes(app, shapes);
+		arena::reset_frame();
+		profile::end(app.profiler, FrameStage::FRAME);
 		SDL_Delay(2);
 	}
 
+	if (profile::has_samples(app.profiler)) {
+		if (profile::dump(app.profiler, gk_profile_file)) {
+			std::cout << "frame timings written to " << gk_profile_file << std::endl;
+		}
+	}
+	relfeed::close(relation_feed);
 }
 
 int app_init(App &app) {
@@ -136,6 +200,77 @@ int app_init(App &app) {
   return 1;
 }
 
+// render a save file into an image without touching SDL video
+// usage: --export <save_file> <out.png|out.ppm> [width height] [--aa]
+int export_headless(int argc, char *argv[]) {
+	bool antialiased = std::string{argv[argc - 1]} == "--aa";
+	if (antialiased) {
+		argc--;
+	}
+	if (argc < 4) {
+		std::cerr << "usage: " << argv[0]
+			<< " --export <save_file> <out.png|out.ppm> [width height] [--aa]"
+			<< std::endl;
+		return 1;
+	}
+	Shapes shapes;
+	if (!serialize::load_appstate(shapes, argv[2])) {
+		return 1;
+	}
+	nodes::rebuild(shapes);
+
+	ExportSettings settings;
+	if (antialiased) {
+		settings.mode = RenderMode::ANTIALIASED;
+	}
+	if (argc >= 6) {
+		settings.width = std::atoi(argv[4]);
+		settings.height = std::atoi(argv[5]);
+	}
+	if (settings.width <= 0 || settings.height <= 0) {
+		std::cerr << "invalid image size" << std::endl;
+		return 1;
+	}
+	settings.format = image::format_from_path(argv[3]);
+	image::fit_scene(settings, shapes);
+	return image::export_scene(shapes, argv[3], settings) ? 0 : 1;
+}
+
+// print a binary relation stream as text for debugging
+// usage: --relations-to-text <in.rel> [out.txt]
+int relations_to_text(int argc, char *argv[]) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0]
+			<< " --relations-to-text <in.rel> [out.txt]" << std::endl;
+		return 1;
+	}
+	bool ok = false;
+	if (argc >= 4) {
+		std::ofstream out{argv[3]};
+		ok = relstream::to_text(argv[2], out);
+	} else {
+		ok = relstream::to_text(argv[2], std::cout);
+	}
+	if (!ok) {
+		std::cerr << "couldn't read " << argv[2] << std::endl;
+	}
+	return ok ? 0 : 1;
+}
+
+namespace app {
+Vec2 screen_to_world(const Camera &camera, const Vec2 &P) {
+	return camera.origin + P * (1.0 / camera.zoom);
+}
+
+void zoom_at(App &app, const double factor) {
+	Vec2 anchor = screen_to_world(app.camera, app.input.mouse_screen);
+	app.camera.zoom = std::clamp(app.camera.zoom * factor,
+															 Camera::min_zoom, Camera::max_zoom);
+	app.camera.origin = anchor - app.input.mouse_screen * (1.0 / app.camera.zoom);
+	app.input.mouse = screen_to_world(app.camera, app.input.mouse_screen);
+}
+} // namespace app
+
 void mode_change_cleanup(App &app, Shapes &shapes, GenShapes &gen_shapes) {
 	// for all modes
 	shapes::clear_tflags_global(shapes);
@@ -162,7 +297,8 @@ void mode_change_cleanup(App &app, Shapes &shapes, GenShapes &gen_shapes) {
 	}
 }
 
-void process_events(App &app, Shapes &shapes, GenShapes &gen_shapes) {
+void process_events(App &app, Shapes &shapes, GenShapes &gen_shapes,
+										RelationDiff &relation_diff) {
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
     switch (event.type) {
@@ -315,9 +451,120 @@ void process_events(App &app, Shapes &shapes, GenShapes &gen_shapes) {
           }
           break;
 				case SDLK_Y:
+					// shift+Y writes the relations of the selection or of all shapes,
+					// ctrl+Y walks from the gen origin
+					if (!event.key.repeat) {
+						if (app.input.ctrl_set) {
+							graph::calculate(shapes, gen_shapes, "Sample.rel");
+						} else if (app.input.shift_set) {
+							gen::calculate_batch_relations(shapes, "relations.rel");
+						} else {
+							gen::calculate_relations(shapes, gen_shapes, "Sample.rel", true);
+						}
+					}
+					break;
+				case SDLK_D:
+					// follow the gen shapes and write changed relations until D again
+					if (!event.key.repeat) {
+						if (relation_diff.enabled) {
+							gen::stop_diff(relation_diff);
+							cout << "relation diff off" << endl;
+						} else if (app.context.mode == AppMode::GEN &&
+											 gen::start_diff(shapes, gen_shapes, relation_diff,
+																			 "relations.diff")) {
+							cout << "relation diff to relations.diff" << endl;
+						}
+					}
+					break;
+				case SDLK_M:
+					// every distinct relation sequence of the drawing, ranked
+					if (!event.key.repeat) {
+						atlas::calculate(shapes, "atlas.txt");
+					}
+					break;
+				case SDLK_Z:
+					// ctrl+Z undo, ctrl+shift+Z redo, not while a shape is in edit
+					if (app.input.ctrl_set && !shapes.edit.in_edit) {
+						if (app.input.shift_set) {
+							history::redo(shapes);
+						} else {
+							history::undo(shapes);
+						}
+					}
+					break;
+				case SDLK_R:
+					// R repeats the selection around the snapped node, shift+R
+					// mirrors it across the reference line, ctrl+R drops the
+					// last instance group
+					if (!event.key.repeat && app.context.mode == AppMode::NORMAL) {
+						if (app.input.ctrl_set) {
+							instances::pop_group(shapes);
+						} else if (app.input.shift_set) {
+							instances::mirror_selected(shapes);
+						} else {
+							instances::rotate_selected(shapes);
+						}
+					}
+					break;
+				case SDLK_W:
+					// W makes the next layer active, shift+W adds one
+					if (!event.key.repeat) {
+						if (app.input.shift_set) {
+							layers::add(shapes);
+						} else {
+							layers::next_active(shapes);
+						}
+						layers::print(shapes.layers);
+					}
+					break;
+				case SDLK_V:
+					// show or hide the active layer
+					if (!event.key.repeat) {
+						layers::toggle_visible(shapes, shapes.layers.active);
+						layers::print(shapes.layers);
+					}
+					break;
+				case SDLK_F:
+					// freeze or unfreeze the active layer
+					if (!event.key.repeat) {
+						layers::toggle_frozen(shapes, shapes.layers.active);
+						shapes::clear_tflags_global(shapes);
+						layers::print(shapes.layers);
+					}
+					break;
+				case SDLK_X:
+					// cut the active layer off from the other layers or connect it
 					if (!event.key.repeat) {
-						std::ofstream outf{ "Sample.txt" };
-						gen::calculate_relations(shapes, gen_shapes, outf);
+						layers::toggle_isolated(shapes, shapes.layers.active);
+						layers::print(shapes.layers);
+					}
+					break;
+				case SDLK_T:
+					// T toggles timing, shift+T the overlay
+					if (!event.key.repeat) {
+						if (app.input.shift_set) {
+							util::toggle_bool(app.profiler.overlay);
+							if (app.profiler.overlay && !app.profiler.enabled) {
+								profile::set_enabled(app.profiler, true);
+							}
+						} else {
+							profile::set_enabled(app.profiler, !app.profiler.enabled);
+						}
+					}
+					break;
+				case SDLK_Q:
+					// toggle antialiased rendering
+					if (!event.key.repeat) {
+						app.video.render_mode =
+							app.video.render_mode == RenderMode::ALIASED ?
+							RenderMode::ANTIALIASED : RenderMode::ALIASED;
+					}
+					break;
+				case SDLK_0:
+					// reset the view
+					if (!event.key.repeat) {
+						app.camera = Camera{};
+						app.input.mouse = app::screen_to_world(app.camera, app.input.mouse_screen);
 					}
 					break;
 				case SDLK_P:
@@ -326,164 +573,47 @@ void process_events(App &app, Shapes &shapes, GenShapes &gen_shapes) {
 					}
 					break;
 			}
+			break;
     case SDL_EVENT_MOUSE_MOTION:
-      app.input.mouse.x = SDL_lround(event.motion.x * app.video.density);
-      app.input.mouse.y = SDL_lround(event.motion.y * app.video.density);
+			if (app.input.panning) {
+				app.camera.origin = app.camera.origin -
+					Vec2{event.motion.xrel, event.motion.yrel} *
+					(app.video.density / app.camera.zoom);
+			}
+      app.input.mouse_screen.x = SDL_lround(event.motion.x * app.video.density);
+      app.input.mouse_screen.y = SDL_lround(event.motion.y * app.video.density);
+			app.input.mouse = app::screen_to_world(app.camera, app.input.mouse_screen);
       break;
+    case SDL_EVENT_MOUSE_WHEEL:
+			app::zoom_at(app, std::pow(1.1, event.wheel.y));
+			break;
     case SDL_EVENT_MOUSE_BUTTON_DOWN:
-      app.input.mouse_left_down = event.button.down;
-			app.input.mouse_click = true;
+			// right button pans the view, every other button draws
+			if (event.button.button == SDL_BUTTON_RIGHT) {
+				app.input.mouse_right_down = true;
+				app.input.panning = true;
+			} else {
+				app.input.mouse_left_down = event.button.down;
+				app.input.mouse_click = true;
+			}
       break;
     case SDL_EVENT_MOUSE_BUTTON_UP:
-      app.input.mouse_left_down = event.button.down;
-      break;
-		}
-	}
-}
-
-// append shape-defining and ixn_points to the IdPoints vector
-void update_nodes(Shapes &shapes) {
-	shapes.ixn_points.clear();
-	shapes.def_points.clear();
-	// append line-line intersections
-	for (size_t i = 0; i < shapes.lines.size(); i++) {
-		Line &l1 = shapes.get_line_by_index(i);
-		for (size_t j = i+1; j < shapes.lines.size(); j++) {
-			Line &l2 = shapes.get_line_by_index(j);
-			vector<Vec2> ixn_points = graphics::Line2_Line2_intersect(l1.geom, l2.geom);
-			// maybe change ixn_point status to concealed
-			bool concealed = false;
-			if (l1.pflags.concealed || l2.pflags.concealed) {
-				concealed = true;
-			}
-			for (auto &ixn_point : ixn_points) {
-				cout << "l1 id: " << l1.id << endl;
-				cout << "l2 id: " << l2.id << endl;
-				shapes::maybe_append_node(shapes.ixn_points,
-															ixn_point, l1.id, concealed);
-				shapes::maybe_append_node(shapes.ixn_points,
-															ixn_point, l2.id, concealed);
-			}
-		}
-	}
-	// append line-circle intersections
-	for (size_t i = 0; i < shapes.circles.size(); i++) {
-		Circle &c = shapes.get_circle_by_index(i);
-		for (size_t j = 0; j < shapes.lines.size(); j++) {
-			Line &l = shapes.get_line_by_index(j);
-			vector<Vec2> ixn_points = graphics::Line2_Circle2_intersect(l.geom, c.geom);
-			// maybe change ixn_point status to concealed
-			bool concealed = false;
-			if (c.pflags.concealed || l.pflags.concealed) {
-				concealed = true;
+			if (event.button.button == SDL_BUTTON_RIGHT) {
+				app.input.mouse_right_down = false;
+				app.input.panning = false;
+			} else {
+				app.input.mouse_left_down = event.button.down;
 			}
-			for (auto &ixn_point : ixn_points) {
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, l.id, concealed);
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, c.id, concealed);
-			}
-		}
-	}
-	// append circle-circle intersections
-	for (size_t i = 0; i < shapes.circles.size(); i++) {
-		Circle &c1 = shapes.get_circle_by_index(i);
-		for (size_t j = i+1; j < shapes.circles.size(); j++) {
-			Circle &c2 = shapes.get_circle_by_index(j);
-			vector<Vec2> ixn_points = graphics::Circle2_Circle2_intersect(c1.geom, c2.geom);
-			// maybe change ixn_point status to concealed
-			bool concealed = false;
-			if (c1.pflags.concealed || c2.pflags.concealed) {
-				concealed = true;
-			}
-			for (auto &ixn_point : ixn_points) {
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, c1.id, concealed);
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, c2.id, concealed);
-			}
-		}
-	}
-
-	// append line-arc intersections
-	for (size_t i = 0; i < shapes.arcs.size(); i++) {
-		Arc &a = shapes.get_arc_by_index(i);
-		for (size_t j = 0; j < shapes.lines.size(); j++) {
-			Line &l = shapes.get_line_by_index(j);
-			vector<Vec2> ixn_points = graphics::Arc2_Line2_intersect(a.geom, l.geom);
-			// maybe change ixn_point status to concealed
-			bool concealed = false;
-			if (a.pflags.concealed || l.pflags.concealed) {
-				concealed = true;
-			}
-			for (auto &ixn_point : ixn_points) {
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, l.id, concealed);
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, a.id, concealed);
-			}
-		}
-	}
-
-	// append arc-circle intersections
-	for (size_t i = 0; i < shapes.arcs.size(); i++) {
-		Arc &a = shapes.get_arc_by_index(i);
-		for (size_t j = i+1; j < shapes.circles.size(); j++) {
-			Circle &c = shapes.get_circle_by_index(j);
-			vector<Vec2> ixn_points = graphics::Arc2_Circle2_intersect(a.geom, c.geom);
-			// maybe change ixn_point status to concealed
-			bool concealed = false;
-			if (a.pflags.concealed || c.pflags.concealed) {
-				concealed = true;
-			}
-			for (auto &ixn_point : ixn_points) {
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, a.id, concealed);
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, c.id, concealed);
-			}
-		}
-	}
-
-	// append arc-arc intersections
-	for (size_t i = 0; i < shapes.arcs.size(); i++) {
-		Arc &a1 = shapes.get_arc_by_index(i);
-		for (size_t j = i+1; j < shapes.arcs.size(); j++) {
-			Arc &a2 = shapes.get_arc_by_index(j);
-			vector<Vec2> ixn_points = graphics::Arc2_Arc2_intersect(a1.geom, a2.geom);
-			// maybe change ixn_point status to concealed
-			bool concealed = false;
-			if (a1.pflags.concealed || a2.pflags.concealed) {
-				concealed = true;
-			}
-			for (auto &ixn_point : ixn_points) {
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, a1.id, concealed);
-				shapes::maybe_append_node(shapes.ixn_points, ixn_point, a2.id, concealed);
-			}
-		}
-	}
-
-	// append shape-defining points
-	for (auto &line : shapes.lines) {
-		bool concealed = false;
-		if (line.pflags.concealed) {
-			concealed = true;
-		}
-		shapes::maybe_append_node(shapes.def_points, line.geom.A, line.id, concealed);
-		shapes::maybe_append_node(shapes.def_points, line.geom.B, line.id, concealed);
-	}
-	for (auto &circle : shapes.circles) {
-		bool concealed = false;
-		if (circle.pflags.concealed) {
-			concealed = true;
-		}
-		shapes::maybe_append_node(shapes.def_points, circle.geom.C, circle.id, concealed);
-		// id_point_maybe_append(app, shapes.def_points, circle.circum_point, circle.id);
-	}
-	for (auto &arc : shapes.arcs) {
-		bool concealed = false;
-		if (arc.pflags.concealed) {
-			concealed = true;
+      break;
 		}
-		shapes::maybe_append_node(shapes.def_points, arc.geom.C, arc.id, concealed);
-		shapes::maybe_append_node(shapes.def_points, arc.geom.S, arc.id, concealed);
-		shapes::maybe_append_node(shapes.def_points, arc.geom.E, arc.id, concealed);
 	}
 }
 
 void check_for_changes(App &app, Shapes &shapes) {
+	// an edit spans frames, its remove and add become one action
+	if (!shapes.edit.in_edit) {
+		history::commit(shapes.history);
+	}
 	if (shapes.quantity_change) {
 		shapes.recalculate = true;
 	} else {
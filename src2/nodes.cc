@@ -0,0 +1,627 @@
+#include "nodes.hpp"
+#include "geometry.hpp"
+#include "spatial.hpp"
+#include "instances.hpp"
+#include "layers.hpp"
+#include "parallel.hpp"
+
+namespace nodes {
+namespace detail {
+Shape *shape_by_id(Shapes &shapes, const int id) {
+	if (Line *line = shapes.get_line_by_id(id)) { return line; }
+	if (Circle *circle = shapes.get_circle_by_id(id)) { return circle; }
+	if (Arc *arc = shapes.get_arc_by_id(id)) { return arc; }
+	return nullptr;
+}
+
+void append_ixn(Shapes &shapes, IxnPoints &points, const Shape &a,
+								const Shape &b) {
+	if (!layers::intersects(shapes.layers, a.pflags.layer, b.pflags.layer)) {
+		return;
+	}
+	bool concealed = a.pflags.concealed || b.pflags.concealed;
+	for (auto &point : points) {
+		size_t k = shapes::maybe_append_node(shapes.ixn_points, point, a.id, concealed);
+		shapes::maybe_append_node(shapes.ixn_points, point, b.id, concealed);
+		index_pair(shapes, k, a.id, b.id);
+		touch_node(shapes, k);
+	}
+}
+
+void recheck_def(Shapes &shapes, Node &node) {
+	node.pflags.concealed = std::all_of(node.ids.begin(), node.ids.end(),
+		[&](int id) {
+			Shape *shape = shape_by_id(shapes, id);
+			return !shape || shape->pflags.concealed;
+		});
+}
+
+void touch(NodeIndex &index, const int id) {
+	if (id < 0) {
+		return;
+	}
+	if (index.revision.size() <= static_cast<size_t>(id)) {
+		index.revision.resize(id + 1, 0);
+	}
+	index.revision[id]++;
+}
+
+void touch_node(Shapes &shapes, const size_t k) {
+	for (int id : shapes.ixn_points[k].ids) {
+		touch(shapes.node_index, id);
+	}
+}
+
+void index_pair(Shapes &shapes, const size_t k, const int a, const int b) {
+	NodeIndex &index = shapes.node_index;
+	if (index.ixn_pairs.size() <= k) {
+		index.ixn_pairs.resize(k + 1);
+	}
+	index.ixn_pairs[k].emplace_back(a, b);
+	for (int id : {a, b}) {
+		if (index.ixn.size() <= static_cast<size_t>(id)) {
+			index.ixn.resize(id + 1);
+		}
+		auto &list = index.ixn[id];
+		if (std::find(list.begin(), list.end(), k) == list.end()) {
+			list.push_back(static_cast<uint32_t>(k));
+			index_param(shapes, id, static_cast<uint32_t>(k));
+		}
+	}
+}
+
+void index_def(NodeIndex &index, const size_t k, const int id) {
+	if (index.def.size() <= static_cast<size_t>(id)) {
+		index.def.resize(id + 1);
+	}
+	auto &list = index.def[id];
+	if (std::find(list.begin(), list.end(), k) == list.end()) {
+		list.push_back(static_cast<uint32_t>(k));
+	}
+}
+
+double param_of(const Shapes &shapes, const int id, const Vec2 &P) {
+	if (id < 0 || static_cast<size_t>(id) >= shapes.by_id.size()) {
+		return 0.0;
+	}
+	const ShapeSlot slot = shapes.by_id[id];
+	if (slot.type == ShapeType::LINE) {
+		const Line *line = shapes.lines.get(slot.handle);
+		if (!line) { return 0.0; }
+		Vec2 d = line->geom.B - line->geom.A;
+		double length2 = vec2::dot(d, d);
+		return length2 > 0.0 ? vec2::dot(P - line->geom.A, d) / length2 : 0.0;
+	}
+	if (slot.type == ShapeType::CIRCLE) {
+		const Circle *circle = shapes.circles.get(slot.handle);
+		return circle ? circle2::get_angle_of_point(circle->geom, P) : 0.0;
+	}
+	if (slot.type == ShapeType::ARC) {
+		const Arc *arc = shapes.arcs.get(slot.handle);
+		return arc ? circle2::get_angle_of_point(arc->geom.to_circle(), P) : 0.0;
+	}
+	return 0.0;
+}
+
+bool param_before(const NodeParam &a, const NodeParam &b) {
+	return a.value < b.value || (a.value == b.value && a.node < b.node);
+}
+
+void index_param(Shapes &shapes, const int id, const uint32_t k) {
+	NodeIndex &index = shapes.node_index;
+	if (index.params.size() <= static_cast<size_t>(id)) {
+		index.params.resize(id + 1);
+	}
+	auto &list = index.params[id];
+	NodeParam param{param_of(shapes, id, shapes.ixn_points[k].P), k};
+	list.insert(std::upper_bound(list.begin(), list.end(), param, param_before),
+							param);
+}
+
+void index_nodes(Shapes &shapes) {
+	NodeIndex &index = shapes.node_index;
+	index.ixn_pairs.resize(shapes.ixn_points.size());
+	index.ixn.assign(shapes.by_id.size(), {});
+	index.def.assign(shapes.by_id.size(), {});
+	for (size_t k = 0; k < shapes.ixn_points.size(); k++) {
+		for (int id : shapes.ixn_points[k].ids) {
+			auto &list = index.ixn[id];
+			if (list.empty() || list.back() != k) {
+				list.push_back(static_cast<uint32_t>(k));
+			}
+		}
+	}
+	for (size_t k = 0; k < shapes.def_points.size(); k++) {
+		for (int id : shapes.def_points[k].ids) {
+			index.def[id].push_back(static_cast<uint32_t>(k));
+		}
+	}
+	index.params.resize(shapes.by_id.size());
+	for (size_t id = 0; id < shapes.by_id.size(); id++) {
+		auto &list = index.params[id];
+		list.clear();
+		for (uint32_t k : index.ixn[id]) {
+			list.push_back(NodeParam{
+				param_of(shapes, static_cast<int>(id), shapes.ixn_points[k].P), k});
+		}
+		std::sort(list.begin(), list.end(), param_before);
+	}
+	index.built = true;
+}
+
+void reconceal_ixn(Shapes &shapes, const size_t k) {
+	bool visible = false;
+	for (auto [a, b] : shapes.node_index.ixn_pairs[k]) {
+		Shape *sa = shape_by_id(shapes, a);
+		Shape *sb = shape_by_id(shapes, b);
+		visible = visible || (sa && sb && !sa->pflags.concealed &&
+													!sb->pflags.concealed);
+	}
+	shapes.ixn_points[k].pflags.concealed = !visible;
+}
+
+void collect_pairs(const Shapes &shapes, const PairJob &job,
+									 std::vector<IxnRecord> &out) {
+	const Geometry &geom = shapes.geometry;
+	const Layers &ls = shapes.layers;
+	std::vector<uint32_t> candidates;
+	// pairs the layer policy forbids and pairs inside a frozen layer with
+	// cached nodes are not tested
+	auto skip = [&](const Shape &a, const Shape &b) {
+		uint8_t la = a.pflags.layer, lb = b.pflags.layer;
+		return !layers::intersects(ls, la, lb) ||
+					 (la == lb && layers::nodes_cached(ls, la));
+	};
+	auto emit = [&](const IxnPoints &points, const Shape &a, const Shape &b) {
+		bool concealed = a.pflags.concealed || b.pflags.concealed;
+		uint8_t la = a.pflags.layer, lb = b.pflags.layer;
+		int layer = la == lb && layers::frozen(ls, la) ? la : -1;
+		for (const Vec2 &P : points) {
+			out.push_back(IxnRecord{P, a.id, b.id, concealed, layer});
+		}
+	};
+	for (size_t i = job.begin; i < job.end; i++) {
+		candidates.clear();
+		switch (job.pairs) {
+		case PairClass::LINE_LINE: {
+			const Line &l1 = shapes.lines[i];
+			geometry::segments_crossing(geom.lines, i, i+1, candidates);
+			for (uint32_t j : candidates) {
+				const Line &l2 = shapes.lines[j];
+				if (skip(l1, l2)) { continue; }
+				emit(graphics::Line2_Line2_intersect(l1.geom, l2.geom), l1, l2);
+			}
+			break;
+		}
+		case PairClass::LINE_CIRCLE: {
+			const Circle &c = shapes.circles[i];
+			geometry::segments_near_circle(geom.lines, c.geom.C, geom.circles.r[i],
+																		 candidates);
+			for (uint32_t j : candidates) {
+				const Line &l = shapes.lines[j];
+				if (skip(l, c)) { continue; }
+				emit(graphics::Line2_Circle2_intersect(l.geom, c.geom), l, c);
+			}
+			break;
+		}
+		case PairClass::CIRCLE_CIRCLE: {
+			const Circle &c1 = shapes.circles[i];
+			geometry::rings_crossing(geom.circles.cx, geom.circles.cy, geom.circles.r,
+															 i+1, c1.geom.C, geom.circles.r[i], candidates);
+			for (uint32_t j : candidates) {
+				const Circle &c2 = shapes.circles[j];
+				if (skip(c1, c2)) { continue; }
+				emit(graphics::Circle2_Circle2_intersect(c1.geom, c2.geom), c1, c2);
+			}
+			break;
+		}
+		case PairClass::LINE_ARC: {
+			const Arc &a = shapes.arcs[i];
+			geometry::segments_near_circle(geom.lines, a.geom.C, geom.arcs.r[i],
+																		 candidates);
+			for (uint32_t j : candidates) {
+				const Line &l = shapes.lines[j];
+				if (skip(l, a)) { continue; }
+				emit(graphics::Arc2_Line2_intersect(a.geom, l.geom), l, a);
+			}
+			break;
+		}
+		case PairClass::ARC_CIRCLE: {
+			const Arc &a = shapes.arcs[i];
+			geometry::rings_crossing(geom.circles.cx, geom.circles.cy, geom.circles.r,
+															 0, a.geom.C, geom.arcs.r[i], candidates);
+			for (uint32_t j : candidates) {
+				const Circle &c = shapes.circles[j];
+				if (skip(a, c)) { continue; }
+				emit(graphics::Arc2_Circle2_intersect(a.geom, c.geom), a, c);
+			}
+			break;
+		}
+		case PairClass::ARC_ARC: {
+			const Arc &a1 = shapes.arcs[i];
+			geometry::rings_crossing(geom.arcs.cx, geom.arcs.cy, geom.arcs.r,
+															 i+1, a1.geom.C, geom.arcs.r[i], candidates);
+			for (uint32_t j : candidates) {
+				const Arc &a2 = shapes.arcs[j];
+				if (skip(a1, a2)) { continue; }
+				emit(graphics::Arc2_Arc2_intersect(a1.geom, a2.geom), a1, a2);
+			}
+			break;
+		}
+		}
+	}
+}
+
+// the pair jobs are uneven, the triangular classes make
+// the early chunks more expensive than the late ones
+void collect_parallel(const Shapes &shapes, const std::vector<PairJob> &jobs,
+											std::vector<std::vector<IxnRecord>> &out) {
+	out.assign(jobs.size(), {});
+	util::parallel_for(jobs.size(), [&](const size_t k) {
+		collect_pairs(shapes, jobs[k], out[k]);
+	});
+}
+
+size_t merge_node(std::vector<Node> &nodes, NodeLookup &lookup, const Vec2 &P,
+									const int shape_id, const bool concealed) {
+	int64_t cx = static_cast<int64_t>(std::floor(P.x));
+	int64_t cy = static_cast<int64_t>(std::floor(P.y));
+	size_t found = nodes.size();
+	for (int64_t y = cy - 1; y <= cy + 1; y++) {
+		for (int64_t x = cx - 1; x <= cx + 1; x++) {
+			auto iter = lookup.cells.find(spatial::detail::cell_key(x, y));
+			if (iter == lookup.cells.end()) { continue; }
+			for (uint32_t k : iter->second) {
+				if (k < found && vec2::equal_int_epsilon(nodes[k].P, P)) {
+					found = k;
+				}
+			}
+		}
+	}
+	if (found == nodes.size()) {
+		lookup.cells[spatial::detail::cell_key(cx, cy)].push_back(
+			static_cast<uint32_t>(nodes.size()));
+		nodes.push_back(Node{shape_id, P});
+		if (shape_id >= 0) {
+			nodes.back().ids.push_back(shape_id);
+		}
+		nodes.back().pflags.concealed = concealed;
+		return found;
+	}
+	// an unconcealed pair shows the node even if both ids are in it already
+	Node &node = nodes[found];
+	if (node.pflags.concealed && !concealed) {
+		node.pflags.concealed = false;
+	}
+	if (shape_id >= 0 && shapes::id_match(node.ids, shape_id)) {
+		return found;
+	}
+	if (shape_id >= 0) {
+		node.ids.push_back(shape_id);
+	}
+	return found;
+}
+} // namespace detail
+
+void rebuild(Shapes &shapes) {
+	assert(geometry::in_sync(shapes));
+	shapes.ixn_points.clear();
+	shapes.def_points.clear();
+	// node indices are about to change
+	shapes.ixn_tflags.clear();
+	shapes.def_tflags.clear();
+	shapes.node_index.ixn_pairs.clear();
+
+	std::vector<PairJob> jobs;
+	auto split = [&](PairClass pairs, size_t n) {
+		for (size_t begin = 0; begin < n; begin += rebuild_chunk) {
+			jobs.push_back(PairJob{pairs, begin, std::min(n, begin + rebuild_chunk)});
+		}
+	};
+	split(PairClass::LINE_LINE, shapes.lines.size());
+	split(PairClass::LINE_CIRCLE, shapes.circles.size());
+	split(PairClass::CIRCLE_CIRCLE, shapes.circles.size());
+	split(PairClass::LINE_ARC, shapes.arcs.size());
+	split(PairClass::ARC_CIRCLE, shapes.arcs.size());
+	split(PairClass::ARC_ARC, shapes.arcs.size());
+	std::vector<std::vector<IxnRecord>> records;
+	detail::collect_parallel(shapes, jobs, records);
+
+	// frozen layers with a valid cache go first, the others fill theirs
+	std::vector<Layer> &ls = shapes.layers.layers;
+	NodeLookup lookup;
+	auto merge = [&](const IxnRecord &r) {
+		size_t k = detail::merge_node(shapes.ixn_points, lookup, r.P, r.id_a,
+																	r.concealed);
+		detail::merge_node(shapes.ixn_points, lookup, r.P, r.id_b, r.concealed);
+		if (shapes.node_index.ixn_pairs.size() <= k) {
+			shapes.node_index.ixn_pairs.resize(k + 1);
+		}
+		shapes.node_index.ixn_pairs[k].emplace_back(r.id_a, r.id_b);
+	};
+	std::vector<bool> refill(ls.size(), false);
+	for (size_t l = 0; l < ls.size(); l++) {
+		if (layers::nodes_cached(shapes.layers, static_cast<uint8_t>(l))) {
+			for (const IxnRecord &r : ls[l].node_records) {
+				merge(r);
+			}
+		} else if (ls[l].frozen) {
+			refill[l] = true;
+			ls[l].node_records.clear();
+		}
+	}
+	for (const auto &job_records : records) {
+		for (const IxnRecord &r : job_records) {
+			merge(r);
+			if (r.layer >= 0 && refill[r.layer]) {
+				ls[r.layer].node_records.push_back(r);
+			}
+		}
+	}
+	for (size_t l = 0; l < ls.size(); l++) {
+		if (refill[l]) {
+			ls[l].nodes_cached = true;
+			ls[l].nodes_revision = ls[l].revision;
+		}
+	}
+
+	// shape-defining points
+	lookup.cells.clear();
+	for (const auto &line : shapes.lines) {
+		bool concealed = line.pflags.concealed;
+		detail::merge_node(shapes.def_points, lookup, line.geom.A, line.id, concealed);
+		detail::merge_node(shapes.def_points, lookup, line.geom.B, line.id, concealed);
+	}
+	for (const auto &circle : shapes.circles) {
+		detail::merge_node(shapes.def_points, lookup, circle.geom.C, circle.id,
+											 circle.pflags.concealed);
+	}
+	for (const auto &arc : shapes.arcs) {
+		bool concealed = arc.pflags.concealed;
+		detail::merge_node(shapes.def_points, lookup, arc.geom.C, arc.id, concealed);
+		detail::merge_node(shapes.def_points, lookup, arc.geom.S, arc.id, concealed);
+		detail::merge_node(shapes.def_points, lookup, arc.geom.E, arc.id, concealed);
+	}
+	instances::append_nodes(shapes);
+	detail::index_nodes(shapes);
+	for (size_t id = 0; id < shapes.by_id.size(); id++) {
+		detail::touch(shapes.node_index, static_cast<int>(id));
+	}
+	spatial::rebuild(shapes.grid, shapes);
+}
+
+// same pair calls and argument order as rebuild so both paths produce
+// the same points
+void insert_shape(Shapes &shapes, const int id) {
+	const Geometry &geom = shapes.geometry;
+	std::vector<uint32_t> candidates;
+	if (id < 0 || static_cast<size_t>(id) >= shapes.by_id.size()) {
+		return;
+	}
+	const ShapeSlot slot = shapes.by_id[id];
+	if (slot.type == ShapeType::LINE) {
+		size_t i = shapes.lines.index_of(slot.handle);
+		if (i == shapes.lines.npos) { return; }
+		Line &l = shapes.lines[i];
+		geometry::segments_crossing(geom.lines, i, 0, candidates);
+		for (uint32_t j : candidates) {
+			if (j == i) { continue; }
+			Line &other = shapes.lines[j];
+			IxnPoints points = j < i ?
+				graphics::Line2_Line2_intersect(other.geom, l.geom) :
+				graphics::Line2_Line2_intersect(l.geom, other.geom);
+			detail::append_ixn(shapes, points, l, other);
+		}
+		candidates.clear();
+		geometry::rings_near_segment(geom.circles.cx, geom.circles.cy,
+																 geom.circles.r, l.geom.A, l.geom.B, candidates);
+		for (uint32_t j : candidates) {
+			Circle &c = shapes.circles[j];
+			IxnPoints points = graphics::Line2_Circle2_intersect(l.geom, c.geom);
+			detail::append_ixn(shapes, points, l, c);
+		}
+		candidates.clear();
+		geometry::rings_near_segment(geom.arcs.cx, geom.arcs.cy, geom.arcs.r,
+																 l.geom.A, l.geom.B, candidates);
+		for (uint32_t j : candidates) {
+			Arc &a = shapes.arcs[j];
+			IxnPoints points = graphics::Arc2_Line2_intersect(a.geom, l.geom);
+			detail::append_ixn(shapes, points, l, a);
+		}
+		detail::index_def(shapes.node_index,
+			shapes::maybe_append_node(shapes.def_points, l.geom.A, l.id, l.pflags.concealed), l.id);
+		detail::index_def(shapes.node_index,
+			shapes::maybe_append_node(shapes.def_points, l.geom.B, l.id, l.pflags.concealed), l.id);
+	} else if (slot.type == ShapeType::CIRCLE) {
+		size_t i = shapes.circles.index_of(slot.handle);
+		if (i == shapes.circles.npos) { return; }
+		Circle &c = shapes.circles[i];
+		geometry::segments_near_circle(geom.lines, c.geom.C, geom.circles.r[i],
+																	 candidates);
+		for (uint32_t j : candidates) {
+			Line &l = shapes.lines[j];
+			IxnPoints points = graphics::Line2_Circle2_intersect(l.geom, c.geom);
+			detail::append_ixn(shapes, points, l, c);
+		}
+		candidates.clear();
+		geometry::rings_crossing(geom.circles.cx, geom.circles.cy, geom.circles.r,
+														 0, c.geom.C, geom.circles.r[i], candidates);
+		for (uint32_t j : candidates) {
+			if (j == i) { continue; }
+			Circle &other = shapes.circles[j];
+			IxnPoints points = j < i ?
+				graphics::Circle2_Circle2_intersect(other.geom, c.geom) :
+				graphics::Circle2_Circle2_intersect(c.geom, other.geom);
+			detail::append_ixn(shapes, points, c, other);
+		}
+		candidates.clear();
+		geometry::rings_crossing(geom.arcs.cx, geom.arcs.cy, geom.arcs.r,
+														 0, c.geom.C, geom.circles.r[i], candidates);
+		for (uint32_t j : candidates) {
+			Arc &a = shapes.arcs[j];
+			IxnPoints points = graphics::Arc2_Circle2_intersect(a.geom, c.geom);
+			detail::append_ixn(shapes, points, a, c);
+		}
+		detail::index_def(shapes.node_index,
+			shapes::maybe_append_node(shapes.def_points, c.geom.C, c.id, c.pflags.concealed), c.id);
+	} else if (slot.type == ShapeType::ARC) {
+		size_t i = shapes.arcs.index_of(slot.handle);
+		if (i == shapes.arcs.npos) { return; }
+		Arc &a = shapes.arcs[i];
+		geometry::segments_near_circle(geom.lines, a.geom.C, geom.arcs.r[i],
+																	 candidates);
+		for (uint32_t j : candidates) {
+			Line &l = shapes.lines[j];
+			IxnPoints points = graphics::Arc2_Line2_intersect(a.geom, l.geom);
+			detail::append_ixn(shapes, points, l, a);
+		}
+		candidates.clear();
+		geometry::rings_crossing(geom.circles.cx, geom.circles.cy, geom.circles.r,
+														 0, a.geom.C, geom.arcs.r[i], candidates);
+		for (uint32_t j : candidates) {
+			Circle &c = shapes.circles[j];
+			IxnPoints points = graphics::Arc2_Circle2_intersect(a.geom, c.geom);
+			detail::append_ixn(shapes, points, a, c);
+		}
+		candidates.clear();
+		geometry::rings_crossing(geom.arcs.cx, geom.arcs.cy, geom.arcs.r,
+														 0, a.geom.C, geom.arcs.r[i], candidates);
+		for (uint32_t j : candidates) {
+			if (j == i) { continue; }
+			Arc &other = shapes.arcs[j];
+			IxnPoints points = j < i ?
+				graphics::Arc2_Arc2_intersect(other.geom, a.geom) :
+				graphics::Arc2_Arc2_intersect(a.geom, other.geom);
+			detail::append_ixn(shapes, points, a, other);
+		}
+		detail::index_def(shapes.node_index,
+			shapes::maybe_append_node(shapes.def_points, a.geom.C, a.id, a.pflags.concealed), a.id);
+		detail::index_def(shapes.node_index,
+			shapes::maybe_append_node(shapes.def_points, a.geom.S, a.id, a.pflags.concealed), a.id);
+		detail::index_def(shapes.node_index,
+			shapes::maybe_append_node(shapes.def_points, a.geom.E, a.id, a.pflags.concealed), a.id);
+	}
+	shapes.grid.built = false;
+}
+
+// only the nodes listed for the ids in node_index are looked at, a node
+// keeps the ids of its remaining pairs. one compaction pass moves the
+// survivors, ixn_pairs along with ixn_points
+void remove_shapes(Shapes &shapes, const std::vector<int> &ids) {
+	NodeIndex &index = shapes.node_index;
+	if (!index.built || !shapes.instance_groups.empty()) {
+		shapes.quantity_change = true;
+		return;
+	}
+	std::vector<Node> &ixn = shapes.ixn_points;
+	std::vector<Node> &def = shapes.def_points;
+	std::vector<bool> gone(shapes.by_id.size(), false);
+	std::vector<bool> ixn_touched(ixn.size(), false);
+	std::vector<bool> def_touched(def.size(), false);
+	for (int id : ids) {
+		if (id < 0 || static_cast<size_t>(id) >= gone.size()) { continue; }
+		gone[id] = true;
+		if (static_cast<size_t>(id) < index.ixn.size()) {
+			for (uint32_t k : index.ixn[id]) { ixn_touched[k] = true; }
+		}
+		if (static_cast<size_t>(id) < index.def.size()) {
+			for (uint32_t k : index.def[id]) { def_touched[k] = true; }
+		}
+	}
+	auto is_gone = [&](const int id) {
+		return id >= 0 && static_cast<size_t>(id) < gone.size() && gone[id];
+	};
+
+	auto &pairs = index.ixn_pairs;
+	pairs.resize(ixn.size());
+	size_t kept = 0;
+	for (size_t k = 0; k < ixn.size(); k++) {
+		Node &node = ixn[k];
+		if (ixn_touched[k]) {
+			detail::touch_node(shapes, k);
+			std::erase_if(pairs[k], [&](const std::pair<int, int> &pair) {
+				return is_gone(pair.first) || is_gone(pair.second);
+			});
+			std::erase_if(node.ids, [&](const int id) {
+				return std::none_of(pairs[k].begin(), pairs[k].end(),
+					[&](const std::pair<int, int> &pair) {
+						return pair.first == id || pair.second == id;
+					});
+			});
+			detail::reconceal_ixn(shapes, k);
+		}
+		if (node.ids.size() >= 2) {
+			if (kept != k) {
+				ixn[kept] = std::move(node);
+				pairs[kept] = std::move(pairs[k]);
+			}
+			kept++;
+		}
+	}
+	ixn.resize(kept);
+	pairs.resize(kept);
+
+	kept = 0;
+	for (size_t k = 0; k < def.size(); k++) {
+		Node &node = def[k];
+		if (def_touched[k]) {
+			std::erase_if(node.ids, is_gone);
+			detail::recheck_def(shapes, node);
+		}
+		if (!node.ids.empty()) {
+			if (kept != k) {
+				def[kept] = std::move(node);
+			}
+			kept++;
+		}
+	}
+	def.resize(kept);
+
+	// node indices moved
+	detail::index_nodes(shapes);
+	shapes.ixn_tflags.clear();
+	shapes.def_tflags.clear();
+	shapes.grid.built = false;
+}
+
+void remove_shape(Shapes &shapes, const int id) {
+	remove_shapes(shapes, std::vector<int>{id});
+}
+
+// nodes of instance copies have no pairs, they need the rebuild
+void refresh_concealed(Shapes &shapes, const int id) {
+	if (!shapes.node_index.built || !shapes.instance_groups.empty()) {
+		shapes.quantity_change = true;
+		return;
+	}
+	if (id < 0 || static_cast<size_t>(id) >= shapes.node_index.ixn.size()) {
+		return;
+	}
+	for (uint32_t k : shapes.node_index.ixn[id]) {
+		detail::reconceal_ixn(shapes, k);
+		detail::touch_node(shapes, k);
+	}
+	if (static_cast<size_t>(id) < shapes.node_index.def.size()) {
+		for (uint32_t k : shapes.node_index.def[id]) {
+			detail::recheck_def(shapes, shapes.def_points[k]);
+		}
+	}
+}
+
+uint32_t revision(const Shapes &shapes, const int id) {
+	const NodeIndex &index = shapes.node_index;
+	if (id < 0 || static_cast<size_t>(id) >= index.revision.size()) {
+		return 0;
+	}
+	return index.revision[id];
+}
+
+const std::vector<NodeParam> &params(const Shapes &shapes, const int id) {
+	static const std::vector<NodeParam> none;
+	const NodeIndex &index = shapes.node_index;
+	if (id < 0 || static_cast<size_t>(id) >= index.params.size()) {
+		return none;
+	}
+	return index.params[id];
+}
+} // namespace nodes
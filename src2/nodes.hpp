@@ -0,0 +1,80 @@
+// nodes.hpp
+#pragma once
+#include "core.hpp"
+#include "graphics.hpp"
+#include "shapes.hpp"
+
+// finds the first node within int_epsilon like maybe_append_node, cells
+// are one unit wide so a match is in the 3x3 block around the point
+struct NodeLookup {
+	std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+};
+// pair classes in the order rebuild merges them
+enum struct PairClass {
+	LINE_LINE, LINE_CIRCLE, CIRCLE_CIRCLE, LINE_ARC, ARC_CIRCLE, ARC_ARC
+};
+// a range of first shapes of one pair class, one unit of parallel work
+struct PairJob {
+	PairClass pairs = PairClass::LINE_LINE;
+	size_t begin = 0;
+	size_t end = 0;
+};
+
+// rebuild recomputes every node when quantity_change is set, the
+// functions below maintain them incrementally for single shapes
+namespace nodes {
+constexpr size_t rebuild_chunk = 32;
+namespace detail {
+// intersections of shapes [begin, end) of the class with their candidates
+void collect_pairs(const Shapes &shapes, const PairJob &job,
+									 std::vector<IxnRecord> &out);
+// runs the jobs on all cores, out[k] holds the records of jobs[k]
+void collect_parallel(const Shapes &shapes, const std::vector<PairJob> &jobs,
+											std::vector<std::vector<IxnRecord>> &out);
+// same result as shapes::maybe_append_node without the linear scan,
+// returns the index of the node
+size_t merge_node(std::vector<Node> &nodes, NodeLookup &lookup, const Vec2 &P,
+									const int shape_id, const bool concealed);
+Shape *shape_by_id(Shapes &shapes, const int id);
+void append_ixn(Shapes &shapes, IxnPoints &points, const Shape &a,
+								const Shape &b);
+// a def node is visible while one of its shapes is unconcealed
+void recheck_def(Shapes &shapes, Node &node);
+// the ixn nodes of the id changed
+void touch(NodeIndex &index, const int id);
+// every shape in ixn node k
+void touch_node(Shapes &shapes, const size_t k);
+// the pair a, b met in ixn node k, the def node k is one of id
+void index_pair(Shapes &shapes, const size_t k, const int a, const int b);
+void index_def(NodeIndex &index, const size_t k, const int id);
+// see NodeParam, only sqrt free arithmetic on lines
+double param_of(const Shapes &shapes, const int id, const Vec2 &P);
+bool param_before(const NodeParam &a, const NodeParam &b);
+// ixn node k goes into the ordered params of id
+void index_param(Shapes &shapes, const int id, const uint32_t k);
+// ixn, def and params of the index from the node ids, nodes of instance copies
+// are listed under their base ids
+void index_nodes(Shapes &shapes);
+// visible while one of the pairs in the node is unconcealed, positions
+// and ids stay as they are
+void reconceal_ixn(Shapes &shapes, const size_t k);
+} // namespace detail
+// all nodes from scratch, pairs are prefiltered on the soa geometry and
+// tested in parallel, the points are merged in the serial order so the
+// result does not depend on the number of threads
+void rebuild(Shapes &shapes);
+// intersections and defining points of the shape with the rest of the scene
+void insert_shape(Shapes &shapes, const int id);
+// take the ids out of their nodes, ixn nodes left with fewer than two
+// shapes and def nodes without a shape go away. the shapes may already be
+// gone from the stores
+void remove_shapes(Shapes &shapes, const std::vector<int> &ids);
+void remove_shape(Shapes &shapes, const int id);
+// after the concealed flag of the shape changed, only the nodes of the
+// shape in node_index are looked at
+void refresh_concealed(Shapes &shapes, const int id);
+// see NodeIndex::revision, 0 for ids the index has not seen
+uint32_t revision(const Shapes &shapes, const int id);
+// ixn nodes of the id ordered along it, concealed ones included
+const std::vector<NodeParam> &params(const Shapes &shapes, const int id);
+} // namespace nodes
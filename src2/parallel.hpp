@@ -0,0 +1,33 @@
+// parallel.hpp
+#pragma once
+#include "core.hpp"
+#include <atomic>
+#include <thread>
+
+namespace util {
+// fn(k) for every k below n, indices are handed out through a counter so
+// uneven jobs balance. the calling thread works too, one thread per core
+// and never more threads than jobs
+template <typename Fn>
+void parallel_for(const size_t n, Fn &&fn) {
+	if (n == 0) {
+		return;
+	}
+	std::atomic<size_t> next{0};
+	auto work = [&] {
+		for (size_t k = next++; k < n; k = next++) {
+			fn(k);
+		}
+	};
+	size_t n_threads = std::min<size_t>(
+		std::max(1u, std::thread::hardware_concurrency()), n);
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < n_threads; t++) {
+		threads.emplace_back(work);
+	}
+	work();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+} // namespace util
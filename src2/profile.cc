@@ -0,0 +1,150 @@
+#include "profile.hpp"
+#include "arena.hpp"
+
+namespace profile {
+const char *stage_name(FrameStage stage) {
+	switch (stage) {
+		case FrameStage::EVENTS:				 return "events";
+		case FrameStage::SNAP:					 return "update_snap";
+		case FrameStage::NODES:					 return "update_nodes";
+		case FrameStage::CONSTRUCT:			 return "construct";
+		case FrameStage::RASTER:				 return "raster";
+		case FrameStage::RENDER_TEXTURE: return "render_texture";
+		case FrameStage::PRESENT:				 return "present";
+		case FrameStage::FRAME:					 return "frame";
+		default:												 return "unknown";
+	}
+}
+
+void set_enabled(Profiler &profiler, const bool enabled) {
+	profiler.enabled = enabled;
+	profiler.armed.fill(false);
+}
+
+void begin(Profiler &profiler, FrameStage stage) {
+	if (!profiler.enabled) { return; }
+	if (stage == FrameStage::FRAME) {
+		profiler.allocations.mark = arena::heap_allocations();
+	}
+	profiler.armed[static_cast<size_t>(stage)] = true;
+	profiler.started[static_cast<size_t>(stage)] = std::chrono::steady_clock::now();
+}
+
+void end(Profiler &profiler, FrameStage stage) {
+	bool &armed = profiler.armed[static_cast<size_t>(stage)];
+	if (!profiler.enabled || !armed) { return; }
+	armed = false;
+	auto t2 = std::chrono::steady_clock::now();
+	std::chrono::duration<double, std::milli> dt_ms =
+		t2 - profiler.started[static_cast<size_t>(stage)];
+	record(profiler, stage, dt_ms.count());
+	if (stage == FrameStage::FRAME) {
+		auto &counts = profiler.allocations;
+		counts.last = arena::heap_allocations() - counts.mark;
+		counts.max = std::max(counts.max, counts.last);
+		counts.total += counts.last;
+		counts.frames++;
+	}
+}
+
+void record(Profiler &profiler, FrameStage stage, double ms) {
+	auto &times = profiler.stages[static_cast<size_t>(stage)];
+	times.samples_ms[times.next] = ms;
+	times.next = (times.next + 1) % times.window;
+	times.filled = std::min(times.filled + 1, times.window);
+
+	double us = ms * 1000.0;
+	size_t bucket = us < 1.0 ? 0 : static_cast<size_t>(std::log2(us)) + 1;
+	times.histogram[std::min(bucket, times.bucket_count - 1)]++;
+	times.total_samples++;
+	times.total_ms += ms;
+	times.max_ms = std::max(times.max_ms, ms);
+}
+
+StageStats stats(const Profiler &profiler, FrameStage stage) {
+	const auto &times = profiler.stages[static_cast<size_t>(stage)];
+	StageStats s;
+	s.samples = times.filled;
+	if (times.filled == 0) { return s; }
+	std::array<double, StageTimes::window> sorted{};
+	std::copy_n(times.samples_ms.begin(), times.filled, sorted.begin());
+	auto last = sorted.begin() + times.filled;
+	size_t p99_index = (times.filled * 99) / 100;
+	std::nth_element(sorted.begin(), sorted.begin() + p99_index, last);
+	s.p99_ms = sorted[p99_index];
+	s.min_ms = *std::min_element(sorted.begin(), last);
+	s.max_ms = *std::max_element(sorted.begin(), last);
+	double sum = 0.0;
+	for (auto iter = sorted.begin(); iter != last; iter++) { sum += *iter; }
+	s.avg_ms = sum / times.filled;
+	return s;
+}
+
+void reset(Profiler &profiler) {
+	for (auto &times : profiler.stages) {
+		times = StageTimes{};
+	}
+	profiler.allocations = FrameAllocations{};
+}
+
+bool has_samples(const Profiler &profiler) {
+	return std::any_of(profiler.stages.begin(), profiler.stages.end(),
+			[](const StageTimes &times) { return times.total_samples > 0; });
+}
+
+bool dump(const Profiler &profiler, const std::string &path) {
+	std::ofstream out(path);
+	if (!out) { return false; }
+	bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+
+	if (json) { out << "{\n  \"stages\": [\n"; }
+	else {
+		out << "stage,samples,min_ms,avg_ms,p99_ms,max_ms,session_avg_ms,"
+			"session_max_ms";
+		for (size_t b = 0; b < StageTimes::bucket_count; b++) {
+			out << ",lt_" << (1ull << b) << "us";
+		}
+		out << "\n";
+	}
+	for (size_t i = 0; i < frame_stage_count; i++) {
+		auto stage = static_cast<FrameStage>(i);
+		const auto &times = profiler.stages[i];
+		StageStats s = stats(profiler, stage);
+		double session_avg = times.total_samples ?
+			times.total_ms / times.total_samples : 0.0;
+		if (json) {
+			out << "    {\"stage\": \"" << stage_name(stage) << "\""
+				<< ", \"samples\": " << times.total_samples
+				<< ", \"min_ms\": " << s.min_ms << ", \"avg_ms\": " << s.avg_ms
+				<< ", \"p99_ms\": " << s.p99_ms << ", \"max_ms\": " << s.max_ms
+				<< ", \"session_avg_ms\": " << session_avg
+				<< ", \"session_max_ms\": " << times.max_ms
+				<< ", \"histogram_log2_us\": [";
+			for (size_t b = 0; b < times.bucket_count; b++) {
+				out << (b ? ", " : "") << times.histogram[b];
+			}
+			out << "]}" << (i + 1 < frame_stage_count ? "," : "") << "\n";
+		} else {
+			out << stage_name(stage) << "," << times.total_samples << ","
+				<< s.min_ms << "," << s.avg_ms << "," << s.p99_ms << "," << s.max_ms
+				<< "," << session_avg << "," << times.max_ms;
+			for (auto count : times.histogram) { out << "," << count; }
+			out << "\n";
+		}
+	}
+	const auto &counts = profiler.allocations;
+	double avg_allocations = counts.frames ?
+		static_cast<double>(counts.total) / counts.frames : 0.0;
+	if (json) {
+		out << "  ],\n  \"heap_allocations_per_frame\": {\"frames\": "
+			<< counts.frames << ", \"last\": " << counts.last
+			<< ", \"avg\": " << avg_allocations << ", \"max\": " << counts.max
+			<< "}\n}\n";
+	} else {
+		out << "\nheap_allocations_per_frame,frames,last,avg,max\n"
+			<< "frame," << counts.frames << "," << counts.last << ","
+			<< avg_allocations << "," << counts.max << "\n";
+	}
+	return !out.fail();
+}
+} // namespace profile
@@ -0,0 +1,75 @@
+// profile.hpp
+#pragma once
+#include "core.hpp"
+
+// per-stage frame timing, toggled at runtime
+enum struct FrameStage {
+	EVENTS,
+	SNAP,
+	NODES,
+	CONSTRUCT,
+	RASTER,
+	RENDER_TEXTURE,
+	PRESENT,
+	FRAME,
+	COUNT,
+};
+constexpr size_t frame_stage_count = static_cast<size_t>(FrameStage::COUNT);
+
+struct StageTimes {
+	// rolling window for min/avg/p99
+	static constexpr size_t window = 512;
+	std::array<double, window> samples_ms{};
+	size_t next = 0;
+	size_t filled = 0;
+	// whole session, log2 buckets of microseconds
+	static constexpr size_t bucket_count = 24;
+	std::array<uint64_t, bucket_count> histogram{};
+	uint64_t total_samples = 0;
+	double total_ms = 0.0;
+	double max_ms = 0.0;
+};
+
+struct StageStats {
+	double min_ms = 0.0;
+	double avg_ms = 0.0;
+	double p99_ms = 0.0;
+	double max_ms = 0.0;
+	size_t samples = 0;
+};
+
+// heap allocations between begin and end of the FRAME stage
+struct FrameAllocations {
+	uint64_t mark = 0;
+	uint64_t last = 0;
+	uint64_t max = 0;
+	uint64_t total = 0;
+	uint64_t frames = 0;
+};
+
+struct Profiler {
+	bool enabled = false;
+	bool overlay = false;
+	std::array<StageTimes, frame_stage_count> stages;
+	FrameAllocations allocations;
+	std::array<std::chrono::steady_clock::time_point, frame_stage_count> started;
+	// a stage is recorded only if its begin ran while enabled, the toggle
+	// happens inside the EVENTS and FRAME stages
+	std::array<bool, frame_stage_count> armed{};
+};
+
+namespace profile {
+const char *stage_name(FrameStage stage);
+// disarms every stage, stages already running when timing is turned on
+// are not recorded
+void set_enabled(Profiler &profiler, const bool enabled);
+void begin(Profiler &profiler, FrameStage stage);
+void end(Profiler &profiler, FrameStage stage);
+void record(Profiler &profiler, FrameStage stage, double ms);
+// stats over the rolling window
+StageStats stats(const Profiler &profiler, FrameStage stage);
+void reset(Profiler &profiler);
+bool has_samples(const Profiler &profiler);
+// csv or json, chosen by file extension
+bool dump(const Profiler &profiler, const std::string &path);
+} // namespace profile
@@ -0,0 +1,87 @@
+#include "relfeed.hpp"
+#include <atomic>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static_assert(sizeof(relfeed_header) == 128);
+static_assert(sizeof(relfeed_frame) == RELFEED_SLOT_SIZE);
+static_assert(offsetof(relfeed_header, head) % 64 == 0);
+
+namespace relfeed {
+bool open(RelationFeed &feed, const std::string &name) {
+	close(feed);
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	// the lock goes away with its process, so only a live owner keeps the
+	// name from being cleared
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		std::cerr << name << " is owned by another instance" << std::endl;
+		::close(fd);
+		return false;
+	}
+	if (ftruncate(fd, RELFEED_SEGMENT_SIZE) != 0) {
+		::close(fd);
+		return false;
+	}
+	void *segment = mmap(nullptr, RELFEED_SEGMENT_SIZE, PROT_READ | PROT_WRITE,
+											 MAP_SHARED, fd, 0);
+	if (segment == MAP_FAILED) {
+		::close(fd);
+		return false;
+	}
+	std::memset(segment, 0, RELFEED_SEGMENT_SIZE);
+	feed.header = static_cast<relfeed_header *>(segment);
+	feed.slots = reinterpret_cast<relfeed_frame *>(
+		static_cast<char *>(segment) + sizeof(relfeed_header));
+	feed.name = name;
+	feed.fd = fd;
+	feed.next = 0;
+	feed.header->version = RELFEED_VERSION;
+	feed.header->n_slots = RELFEED_SLOTS;
+	feed.header->slot_size = RELFEED_SLOT_SIZE;
+	// readers check the magic last
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(feed.header->magic, "GEOFEED", 8);
+	return true;
+}
+
+void close(RelationFeed &feed) {
+	if (!feed.header) {
+		return;
+	}
+	munmap(feed.header, RELFEED_SEGMENT_SIZE);
+	shm_unlink(feed.name.c_str());
+	::close(feed.fd);
+	feed = RelationFeed{};
+}
+
+void publish(RelationFeed &feed, const int shape_id, const ShapeType type,
+						 const uint8_t source, const uint16_t depth, const double *values,
+						 const size_t count) {
+	if (!feed.header) {
+		return;
+	}
+	const uint64_t frame = feed.next;
+	relfeed_frame &slot = feed.slots[frame % RELFEED_SLOTS];
+	std::atomic_ref<uint64_t> sequence{slot.sequence};
+	sequence.store(2 * frame + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	uint32_t stored = static_cast<uint32_t>(
+		std::min<size_t>(count, RELFEED_MAX_VALUES));
+	slot.shape_id = shape_id;
+	slot.type = static_cast<uint8_t>(type);
+	slot.source = source;
+	slot.depth = depth;
+	slot.count = stored;
+	slot.total = static_cast<uint32_t>(count);
+	std::memcpy(slot.values, values, stored * sizeof(double));
+	sequence.store(2 * frame + 2, std::memory_order_release);
+	feed.next = frame + 1;
+	std::atomic_ref<uint64_t>{feed.header->head}.store(feed.next,
+																									 std::memory_order_release);
+}
+} // namespace relfeed
@@ -0,0 +1,75 @@
+/* relfeed.h */
+/* layout of the shared memory relation feed, shared by the app that
+ * writes it (relfeed.hpp) and the C reader (relfeed_reader.c). plain C so
+ * an external in a sequencer can include it. */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RELFEED_NAME "/geo_app_relations"
+#define RELFEED_VERSION 1
+/* power of two, a reader that falls more than this behind loses frames */
+#define RELFEED_SLOTS 64
+#define RELFEED_SLOT_SIZE 8192
+#define RELFEED_MAX_VALUES ((RELFEED_SLOT_SIZE - 24) / 8)
+
+/* frame source */
+#define RELFEED_SOURCE_SEQUENCE 0 /* gen::calculate_relations */
+#define RELFEED_SOURCE_LIVE 1 /* relation preview of a gen shape */
+
+/* one relation vector. sequence is odd while the app writes the slot and
+ * 2 * frame + 2 once frame is complete. type is 3 line, 4 circle, 5 arc.
+ * count values are stored, total is the length before values past
+ * RELFEED_MAX_VALUES were cut off */
+typedef struct relfeed_frame {
+	uint64_t sequence;
+	int32_t shape_id;
+	uint8_t type;
+	uint8_t source;
+	uint16_t depth;
+	uint32_t count;
+	uint32_t total;
+	double values[RELFEED_MAX_VALUES];
+} relfeed_frame;
+
+/* head is the number of frames published, frame f is in slot
+ * f % RELFEED_SLOTS. head and every sequence are written with release
+ * and read with acquire order, nothing else in the segment changes */
+typedef struct relfeed_header {
+	char magic[8]; /* "GEOFEED\0" */
+	uint32_t version;
+	uint32_t n_slots;
+	uint32_t slot_size;
+	uint32_t reserved;
+	uint8_t pad0[40];
+	uint64_t head;
+	uint8_t pad1[56];
+} relfeed_header;
+
+#define RELFEED_SEGMENT_SIZE \
+	(sizeof(relfeed_header) + (size_t)RELFEED_SLOTS * RELFEED_SLOT_SIZE)
+
+/* reader side, see relfeed_reader.c */
+typedef struct relfeed_reader {
+	const relfeed_header *header;
+	const relfeed_frame *slots;
+	size_t size;
+	uint64_t next;
+	uint64_t lost;
+} relfeed_reader;
+
+/* maps the feed read only and starts at the newest frame, 0 on success */
+int relfeed_open(relfeed_reader *reader, const char *name);
+void relfeed_close(relfeed_reader *reader);
+/* copies the next frame into out without a syscall. 1 with a frame, 0 if
+ * there is nothing new. frames the app overwrote before they were read
+ * are skipped and added to lost */
+int relfeed_poll(relfeed_reader *reader, relfeed_frame *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,32 @@
+// relfeed.hpp
+#pragma once
+#include "core.hpp"
+#include "shapes.hpp"
+#include "relfeed.h"
+
+// writing end of the shared memory relation feed, see relfeed.h. one
+// producer, any number of readers that never block it: a frame goes into
+// the next slot behind a seqlock, readers that fell behind lose frames
+struct RelationFeed {
+	relfeed_header *header = nullptr;
+	relfeed_frame *slots = nullptr;
+	std::string name;
+	// holds the lock that makes this instance the owner of the name
+	int fd = -1;
+	// frames published, head in the segment follows it
+	uint64_t next = 0;
+};
+
+namespace relfeed {
+// creates the segment and starts at frame 0. a segment left by an instance
+// that is gone is taken over, false if another running instance owns it
+// or shared memory is not available
+bool open(RelationFeed &feed, const std::string &name = RELFEED_NAME);
+// unmaps, removes the name and gives up the ownership, readers keep
+// their mapping
+void close(RelationFeed &feed);
+// no syscall, values past RELFEED_MAX_VALUES are cut off
+void publish(RelationFeed &feed, const int shape_id, const ShapeType type,
+						 const uint8_t source, const uint16_t depth, const double *values,
+						 const size_t count);
+} // namespace relfeed
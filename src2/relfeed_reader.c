@@ -0,0 +1,79 @@
+/* relfeed_reader.c */
+/* reader of the shared memory relation feed, only relfeed_open and
+ * relfeed_close make syscalls. build with make feed_reader */
+#define _POSIX_C_SOURCE 200809L
+#include "relfeed.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int relfeed_open(relfeed_reader *reader, const char *name) {
+	memset(reader, 0, sizeof(*reader));
+	int fd = shm_open(name ? name : RELFEED_NAME, O_RDONLY, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	void *segment = mmap(NULL, RELFEED_SEGMENT_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (segment == MAP_FAILED) {
+		return -1;
+	}
+	const relfeed_header *header = (const relfeed_header *)segment;
+	if (memcmp(header->magic, "GEOFEED", 8) != 0 ||
+			header->version != RELFEED_VERSION || header->n_slots != RELFEED_SLOTS ||
+			header->slot_size != RELFEED_SLOT_SIZE) {
+		munmap(segment, RELFEED_SEGMENT_SIZE);
+		return -1;
+	}
+	reader->header = header;
+	reader->slots = (const relfeed_frame *)((const char *)segment +
+																					sizeof(relfeed_header));
+	reader->size = RELFEED_SEGMENT_SIZE;
+	reader->next = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+void relfeed_close(relfeed_reader *reader) {
+	if (reader->header) {
+		munmap((void *)reader->header, reader->size);
+	}
+	memset(reader, 0, sizeof(*reader));
+}
+
+/* seqlock read: the slot is taken if its sequence is the complete one of
+ * the frame before and after the copy */
+int relfeed_poll(relfeed_reader *reader, relfeed_frame *out) {
+	for (;;) {
+		uint64_t head = __atomic_load_n(&reader->header->head, __ATOMIC_ACQUIRE);
+		if (head < reader->next) {
+			/* the app opened the feed again */
+			reader->next = head;
+		}
+		if (reader->next == head) {
+			return 0;
+		}
+		if (head - reader->next > RELFEED_SLOTS) {
+			reader->lost += head - RELFEED_SLOTS - reader->next;
+			reader->next = head - RELFEED_SLOTS;
+		}
+		uint64_t frame = reader->next;
+		const relfeed_frame *slot = &reader->slots[frame % RELFEED_SLOTS];
+		uint64_t complete = 2 * frame + 2;
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) == complete) {
+			memcpy(out, slot, offsetof(relfeed_frame, values));
+			uint32_t count = out->count <= RELFEED_MAX_VALUES ? out->count
+																												: RELFEED_MAX_VALUES;
+			memcpy(out->values, slot->values, count * sizeof(double));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == complete) {
+				out->count = count;
+				reader->next++;
+				return 1;
+			}
+		}
+		/* overwritten before or while it was copied */
+		reader->lost++;
+		reader->next++;
+	}
+}
@@ -0,0 +1,187 @@
+#include "relstream.hpp"
+#include <bit>
+
+static_assert(std::endian::native == std::endian::little,
+							"relation streams are little endian");
+
+namespace relstream {
+namespace detail {
+uint32_t fitting_frac_bits(const double max_value, const uint32_t frac_bits) {
+	uint32_t bits = frac_bits;
+	while (bits > 0 && max_value * std::ldexp(1.0, bits) >=
+				 static_cast<double>(std::numeric_limits<uint32_t>::max())) {
+		bits--;
+	}
+	return bits;
+}
+
+uint32_t quantize(const double value, const uint32_t frac_bits) {
+	double scaled = std::round(value * std::ldexp(1.0, frac_bits));
+	return static_cast<uint32_t>(std::clamp(scaled, 0.0,
+		static_cast<double>(std::numeric_limits<uint32_t>::max())));
+}
+
+double dequantize(const uint32_t value, const uint32_t frac_bits) {
+	return std::ldexp(static_cast<double>(value), -static_cast<int>(frac_bits));
+}
+
+void flush(RelationWriter &writer) {
+	writer.out.write(writer.buf.data(), writer.buf.size());
+	writer.buf.clear();
+}
+} // namespace detail
+
+bool begin(RelationWriter &writer, const std::string &path,
+					 const RelationEncoding encoding, const uint32_t frac_bits) {
+	writer.out.open(path, std::ios::binary);
+	if (!writer.out) {
+		return false;
+	}
+	writer.header = RelationStreamHeader{};
+	writer.header.encoding = encoding;
+	writer.header.frac_bits = encoding == RelationEncoding::Q32 ? frac_bits : 0;
+	writer.buf.clear();
+	writer.buf.reserve(RelationWriter::flush_size + 4096);
+	writer.buf.insert(writer.buf.end(), RelationStreamHeader::magic,
+										RelationStreamHeader::magic + 8);
+	detail::put(writer.buf, writer.header.version);
+	detail::put(writer.buf, static_cast<uint32_t>(writer.header.encoding));
+	detail::put(writer.buf, writer.header.frac_bits);
+	detail::put(writer.buf, uint32_t{0});
+	detail::put(writer.buf, uint64_t{0});
+	return true;
+}
+
+void write(RelationWriter &writer, const Relation &relation,
+					 const double *values) {
+	std::vector<char> &buf = writer.buf;
+	bool f64 = writer.header.encoding == RelationEncoding::F64;
+	uint32_t frac_bits = 0;
+	if (!f64) {
+		double max_value = 0.0;
+		for (uint32_t i = 0; i < relation.count; i++) {
+			max_value = std::max(max_value, values[i]);
+		}
+		frac_bits = detail::fitting_frac_bits(max_value, writer.header.frac_bits);
+	}
+	detail::put(buf, static_cast<int32_t>(relation.shape_id));
+	detail::put(buf, static_cast<uint8_t>(relation.type));
+	detail::put(buf, static_cast<uint8_t>(relation.clockwise));
+	detail::put(buf, static_cast<uint16_t>(frac_bits));
+	detail::put(buf, relation.origin.x);
+	detail::put(buf, relation.origin.y);
+	detail::put(buf, relation.count);
+	detail::put(buf, relation.depth);
+	if (f64) {
+		const char *bytes = reinterpret_cast<const char *>(values);
+		buf.insert(buf.end(), bytes, bytes + relation.count * sizeof(double));
+	} else {
+		for (uint32_t i = 0; i < relation.count; i++) {
+			detail::put(buf, detail::quantize(values[i], frac_bits));
+		}
+	}
+	writer.header.n_records++;
+	if (buf.size() >= RelationWriter::flush_size) {
+		detail::flush(writer);
+	}
+}
+
+void write_batches(RelationWriter &writer,
+									 const std::vector<RelationBatch> &batches) {
+	for (const RelationBatch &batch : batches) {
+		for (const Relation &relation : batch.relations) {
+			write(writer, relation, batch.values.data() + relation.begin);
+		}
+	}
+}
+
+bool finish(RelationWriter &writer) {
+	detail::flush(writer);
+	// the record count is the last field of the header
+	writer.out.seekp(24);
+	writer.out.write(reinterpret_cast<const char *>(&writer.header.n_records),
+									 sizeof(uint64_t));
+	writer.out.close();
+	return !writer.out.fail();
+}
+
+bool open(RelationReader &reader, const std::string &path) {
+	reader.in.open(path, std::ios::binary);
+	char bytes[32];
+	if (!reader.in || !reader.in.read(bytes, 32) ||
+			std::memcmp(bytes, RelationStreamHeader::magic, 8) != 0) {
+		return false;
+	}
+	RelationStreamHeader &header = reader.header;
+	header.version = detail::get<uint32_t>(bytes + 8);
+	header.encoding = static_cast<RelationEncoding>(detail::get<uint32_t>(bytes + 12));
+	header.frac_bits = detail::get<uint32_t>(bytes + 16);
+	header.n_records = detail::get<uint64_t>(bytes + 24);
+	reader.records_read = 0;
+	return (header.version == 1 ||
+					header.version == RelationStreamHeader::current_version) &&
+				 (header.encoding == RelationEncoding::F64 ||
+					header.encoding == RelationEncoding::Q32) &&
+				 header.frac_bits < 32;
+}
+
+bool next(RelationReader &reader, Relation &relation,
+					std::pmr::vector<double> &out) {
+	// a stream that was not finished has no count, read until the end
+	if (reader.header.n_records != 0 &&
+			reader.records_read == reader.header.n_records) {
+		return false;
+	}
+	const std::streamsize head = reader.header.version == 1 ? 28 : 32;
+	char bytes[32];
+	if (!reader.in.read(bytes, head) || detail::get<uint16_t>(bytes + 6) >= 32) {
+		return false;
+	}
+	relation.shape_id = detail::get<int32_t>(bytes);
+	relation.type = static_cast<ShapeType>(detail::get<uint8_t>(bytes + 4));
+	relation.clockwise = detail::get<uint8_t>(bytes + 5) != 0;
+	uint32_t frac_bits = detail::get<uint16_t>(bytes + 6);
+	relation.origin.x = detail::get<double>(bytes + 8);
+	relation.origin.y = detail::get<double>(bytes + 16);
+	relation.count = detail::get<uint32_t>(bytes + 24);
+	relation.depth = head == 32 ? detail::get<uint32_t>(bytes + 28) : 0;
+	relation.begin = static_cast<uint32_t>(out.size());
+	bool f64 = reader.header.encoding == RelationEncoding::F64;
+	size_t n_bytes = relation.count * (f64 ? sizeof(double) : sizeof(uint32_t));
+	reader.buf.resize(n_bytes);
+	if (!reader.in.read(reader.buf.data(), n_bytes)) {
+		return false;
+	}
+	for (uint32_t i = 0; i < relation.count; i++) {
+		out.push_back(f64 ?
+			detail::get<double>(reader.buf.data() + i * sizeof(double)) :
+			detail::dequantize(detail::get<uint32_t>(
+				reader.buf.data() + i * sizeof(uint32_t)), frac_bits));
+	}
+	reader.records_read++;
+	return true;
+}
+
+// read in batches of a few thousand records so memory stays bounded
+bool to_text(const std::string &path, std::ostream &out) {
+	constexpr size_t batch_records = 4096;
+	RelationReader reader;
+	if (!open(reader, path)) {
+		return false;
+	}
+	std::vector<RelationBatch> batches(1);
+	RelationBatch &batch = batches[0];
+	Relation relation;
+	while (next(reader, relation, batch.values)) {
+		batch.relations.push_back(relation);
+		if (batch.relations.size() == batch_records) {
+			gen::write_relations(batches, out);
+			batch.relations.clear();
+			batch.values.clear();
+		}
+	}
+	gen::write_relations(batches, out);
+	return reader.header.n_records == 0 ||
+				 reader.records_read == reader.header.n_records;
+}
+} // namespace relstream
@@ -0,0 +1,83 @@
+// relstream.hpp
+#pragma once
+#include "core.hpp"
+#include "gen.hpp"
+
+// binary relation stream, host byte order which is little endian on every
+// target. a 32 byte header
+//   char magic[8] "GEOREL\0\0", u32 version, u32 encoding, u32 frac_bits,
+//   u32 reserved, u64 record count (0 until the writer finished)
+// then one record per relation
+//   i32 shape id, u8 ShapeType, u8 clockwise, u16 record frac_bits,
+//   f64 origin x, f64 origin y, u32 count, u32 depth, count values
+// version 1 records have no depth, they are read with depth 0
+// values are f64, or u32 fixed point. a quantized record uses the header
+// frac_bits or fewer if its largest value would not fit, relations from
+// an origin close to the end of a line get large
+enum struct RelationEncoding : uint32_t { F64 = 0, Q32 = 1 };
+
+struct RelationStreamHeader {
+	static constexpr char magic[8] = {'G', 'E', 'O', 'R', 'E', 'L', 0, 0};
+	static constexpr uint32_t current_version = 2;
+	static constexpr uint32_t default_frac_bits = 24;
+	uint32_t version = current_version;
+	RelationEncoding encoding = RelationEncoding::F64;
+	uint32_t frac_bits = 0;
+	uint64_t n_records = 0;
+};
+
+// records are collected in buf and written in blocks of flush_size
+struct RelationWriter {
+	static constexpr size_t flush_size = size_t{1} << 20;
+	std::ofstream out;
+	RelationStreamHeader header;
+	std::vector<char> buf;
+};
+
+struct RelationReader {
+	std::ifstream in;
+	RelationStreamHeader header;
+	uint64_t records_read = 0;
+	std::vector<char> buf;
+};
+
+namespace relstream {
+namespace detail {
+template <typename T>
+void put(std::vector<char> &buf, const T value) {
+	const char *bytes = reinterpret_cast<const char *>(&value);
+	buf.insert(buf.end(), bytes, bytes + sizeof(T));
+}
+template <typename T>
+T get(const char *bytes) {
+	T value;
+	std::memcpy(&value, bytes, sizeof(T));
+	return value;
+}
+// most fractional bits that keep max_value below 2^32
+uint32_t fitting_frac_bits(const double max_value, const uint32_t frac_bits);
+uint32_t quantize(const double value, const uint32_t frac_bits);
+double dequantize(const uint32_t value, const uint32_t frac_bits);
+void flush(RelationWriter &writer);
+} // namespace detail
+
+// frac_bits only applies to Q32
+bool begin(RelationWriter &writer, const std::string &path,
+					 const RelationEncoding encoding = RelationEncoding::F64,
+					 const uint32_t frac_bits = RelationStreamHeader::default_frac_bits);
+void write(RelationWriter &writer, const Relation &relation,
+					 const double *values);
+void write_batches(RelationWriter &writer,
+									 const std::vector<RelationBatch> &batches);
+// flushes and fills in the record count
+bool finish(RelationWriter &writer);
+
+bool open(RelationReader &reader, const std::string &path);
+// false at the end of the stream or on a short record, values are
+// appended to out and relation.begin is where they start
+bool next(RelationReader &reader, Relation &relation,
+					std::pmr::vector<double> &out);
+
+// the text lines of gen::write_relations
+bool to_text(const std::string &path, std::ostream &out);
+} // namespace relstream
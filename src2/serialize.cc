@@ -1,4 +1,8 @@
 #include "serialize.hpp"
+#include "history.hpp"
+#include "instances.hpp"
+#include "layers.hpp"
+#include "nodes.hpp"
 
 namespace serialize {
 void detail::serialize_line(const Line &line, ofstream &save_out) {
@@ -29,19 +33,25 @@ Circle detail::deserialize_circle(ifstream &save_in) {
 	return circle;
 }
 
+// the last field holds concealed in bit 0 and counterclockwise in bit 1,
+// files from before the direction was saved have 0 or 1 there and load
+// clockwise arcs
 void detail::serialize_arc(const Arc &arc, ofstream &out) {
+	int flags = static_cast<int>(arc.pflags.concealed) |
+							(arc.geom.clockwise ? 0 : 2);
 	out << arc.geom.C.x << " " << arc.geom.C.y << " "
 			<< arc.geom.S.x << " " << arc.geom.S.y << " "
 			<< arc.geom.E.x << " " << arc.geom.E.y << " "
-			<< static_cast<int>(arc.pflags.concealed) << " ";
+			<< flags << " ";
 }
 Arc detail::deserialize_arc(ifstream &in) {
 	Arc arc;
-	int concealed_int {};
+	int flags {};
 	in >> arc.geom.C.x >> arc.geom.C.y
 		 >> arc.geom.S.x >> arc.geom.S.y
-		 >> arc.geom.E.x >> arc.geom.E.y >> concealed_int;
-	arc.pflags.concealed = static_cast<bool>(concealed_int);
+		 >> arc.geom.E.x >> arc.geom.E.y >> flags;
+	arc.pflags.concealed = static_cast<bool>(flags & 1);
+	arc.geom.clockwise = !(flags & 2);
 
 	arc.geom.S_angle =
 			circle2::get_angle_of_point(arc.geom.to_circle(), arc.geom.S);
@@ -50,6 +60,96 @@ Arc detail::deserialize_arc(ifstream &in) {
 	return arc;
 }
 
+void detail::serialize_group(const InstanceGroup &group,
+														 const std::vector<int> &file_ids, ofstream &out) {
+	std::vector<int> ids;
+	for (int id : group.base_ids) {
+		if (id >= 0 && static_cast<size_t>(id) < file_ids.size() && file_ids[id] >= 0) {
+			ids.push_back(file_ids[id]);
+		}
+	}
+	out << static_cast<int>(group.kind) << " "
+			<< group.pivot.x << " " << group.pivot.y << " " << group.fold << " "
+			<< group.axis.A.x << " " << group.axis.A.y << " "
+			<< group.axis.B.x << " " << group.axis.B.y << " " << ids.size() << " ";
+	for (int id : ids) {
+		out << id << " ";
+	}
+}
+bool detail::deserialize_group(ifstream &in, const size_t n_shapes,
+															 InstanceGroup &out) {
+	int kind_int {};
+	Vec2 pivot{};
+	int fold {};
+	Line2 axis{};
+	size_t n_ids {};
+	in >> kind_int >> pivot.x >> pivot.y >> fold
+		 >> axis.A.x >> axis.A.y >> axis.B.x >> axis.B.y >> n_ids;
+	if (!in || n_ids > n_shapes || fold < 2 ||
+			(kind_int != static_cast<int>(InstanceKind::ROTATION) &&
+			 kind_int != static_cast<int>(InstanceKind::MIRROR))) {
+		return false;
+	}
+	// the shapes of the file get the ids 0, 1, ... when they are added
+	std::vector<int> ids(n_ids);
+	for (auto &id : ids) {
+		if (!(in >> id) || id < 0 || static_cast<size_t>(id) >= n_shapes) {
+			return false;
+		}
+	}
+	if (static_cast<InstanceKind>(kind_int) == InstanceKind::MIRROR) {
+		out = instances::mirror(std::move(ids), axis);
+	} else {
+		out = instances::rotation(std::move(ids), pivot, fold);
+	}
+	return true;
+}
+
+// layer flags and policy rows, then the layer of every shape in file order
+void detail::serialize_layers(const Shapes &shapes, ofstream &out) {
+	const Layers &layers = shapes.layers;
+	out << layers.layers.size() << " ";
+	for (size_t i = 0; i < layers.layers.size(); i++) {
+		out << static_cast<int>(layers.layers[i].visible) << " "
+				<< static_cast<int>(layers.layers[i].frozen) << " "
+				<< layers.intersects[i] << " ";
+	}
+	out << static_cast<int>(layers.active) << " "
+			<< shapes.lines.size() + shapes.circles.size() + shapes.arcs.size() << " ";
+	for (auto &line : shapes.lines) { out << static_cast<int>(line.pflags.layer) << " "; }
+	for (auto &circle : shapes.circles) { out << static_cast<int>(circle.pflags.layer) << " "; }
+	for (auto &arc : shapes.arcs) { out << static_cast<int>(arc.pflags.layer) << " "; }
+	out << endl;
+}
+// files from before layers keep everything on layer 0
+void detail::deserialize_layers(Shapes &shapes, ifstream &in) {
+	size_t n_layers {};
+	if (!(in >> n_layers) || n_layers == 0 || n_layers > Layers::max_layers) {
+		return;
+	}
+	Layers &layers = shapes.layers;
+	layers.layers.assign(n_layers, Layer{});
+	for (size_t i = 0; i < n_layers; i++) {
+		int visible {}, frozen {};
+		in >> visible >> frozen >> layers.intersects[i];
+		layers.layers[i].visible = static_cast<bool>(visible);
+		layers.layers[i].frozen = static_cast<bool>(frozen);
+	}
+	int active {};
+	size_t n_shapes {};
+	in >> active >> n_shapes;
+	layers.active = static_cast<uint8_t>(std::clamp<int>(active, 0, n_layers - 1));
+	// shapes were loaded with ids 0, 1, ... in file order
+	for (size_t id = 0; id < n_shapes && id < shapes.by_id.size(); id++) {
+		int layer {};
+		in >> layer;
+		if (Shape *shape = nodes::detail::shape_by_id(shapes, static_cast<int>(id))) {
+			shape->pflags.layer = static_cast<uint8_t>(
+				std::clamp<int>(layer, 0, n_layers - 1));
+		}
+	}
+}
+
 void save_appstate(const Shapes &shapes, const std::string &save_file) {
 	std::ofstream save_out(save_file);
 	assert(save_out);
@@ -71,34 +171,78 @@ void save_appstate(const Shapes &shapes, const std::string &save_file) {
 		detail::serialize_arc(arc, save_out);
 	}
 	save_out << endl;
+
+	// shapes are loaded in file order and get ids 0, 1, ...
+	std::vector<int> file_ids(shapes.by_id.size(), -1);
+	int next_id = 0;
+	for (auto &line : shapes.lines) { file_ids[line.id] = next_id++; }
+	for (auto &circle : shapes.circles) { file_ids[circle.id] = next_id++; }
+	for (auto &arc : shapes.arcs) { file_ids[arc.id] = next_id++; }
+	save_out << shapes.instance_groups.size() << " ";
+	for (auto &group : shapes.instance_groups) {
+		detail::serialize_group(group, file_ids, save_out);
+	}
+	save_out << endl;
+
+	detail::serialize_layers(shapes, save_out);
 }
 
 // clear shapes and load saved ones
 // the amout of shapes to load per line is determined by the start value
-void load_appstate(Shapes &shapes, const std::string &save_file) {
+bool load_appstate(Shapes &shapes, const std::string &save_file) {
 	std::ifstream in(save_file);
-	assert(in);
-	shapes.quantity_change = true;
-
-	shapes.lines.clear();
-	size_t n_lines;
+	if (!in) {
+		std::cerr << "couldn't open " << save_file << std::endl;
+		return false;
+	}
+	// the shapes are read before anything is cleared, a file that is not a
+	// save leaves the scene as it was
+	ShapeBatch batch;
+	size_t n_lines {};
 	in >> n_lines;
-	for (size_t i = 0; i < n_lines; i++) {
-	 shapes.lines.push_back(detail::deserialize_line(in));
+	for (size_t i = 0; i < n_lines && in; i++) {
+		batch.lines.push_back(detail::deserialize_line(in));
 	}
 
-	shapes.circles.clear();
-	size_t n_circles;
+	size_t n_circles {};
 	in >> n_circles;
-	for (size_t i = 0; i < n_circles; i++) {
-		shapes.circles.push_back(detail::deserialize_circle(in));
+	for (size_t i = 0; i < n_circles && in; i++) {
+		batch.circles.push_back(detail::deserialize_circle(in));
 	}
 
-	shapes.arcs.clear();
-	size_t n_arcs;
+	size_t n_arcs {};
 	in >> n_arcs;
-	for (size_t i = 0; i < n_arcs; i++) {
-		shapes.arcs.push_back(detail::deserialize_arc(in));
+	for (size_t i = 0; i < n_arcs && in; i++) {
+		batch.arcs.push_back(detail::deserialize_arc(in));
+	}
+	if (!in) {
+		std::cerr << save_file << " is not a save file" << std::endl;
+		return false;
+	}
+
+	// files from before instance groups end here
+	std::vector<InstanceGroup> groups;
+	size_t n_groups {};
+	if (in >> n_groups) {
+		for (size_t i = 0; i < n_groups; i++) {
+			InstanceGroup group;
+			if (!detail::deserialize_group(in, batch.size(), group)) {
+				std::cerr << save_file << ": instance group " << i << " is invalid"
+					<< std::endl;
+				return false;
+			}
+			groups.push_back(std::move(group));
+		}
+	}
+	// loaded shapes get fresh ids in file order
+	shapes::clear_all(shapes);
+	shapes::add_batch(shapes, std::move(batch));
+	for (auto &group : groups) {
+		instances::add_group(shapes, std::move(group));
 	}
+	detail::deserialize_layers(shapes, in);
+	// a loaded file is the new starting point, not an undoable action
+	history::clear(shapes.history);
+	return true;
 }
 } // namespace serialize
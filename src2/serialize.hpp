@@ -13,8 +13,18 @@ void serialize_circle(const Circle &circle_shape, ofstream &out);
 Circle deserialize_circle(ifstream &in);
 void serialize_arc(const Arc &arc_shape, ofstream &out);
 Arc deserialize_arc(ifstream &in);
+// base ids are written as the ids the shapes get on load
+void serialize_group(const InstanceGroup &group, const std::vector<int> &file_ids,
+										 ofstream &out);
+// false if the group does not read, has a fold below 2 or a base id that
+// is not one of the n_shapes shapes of the file
+bool deserialize_group(ifstream &in, const size_t n_shapes, InstanceGroup &out);
+void serialize_layers(const Shapes &shapes, ofstream &out);
+void deserialize_layers(Shapes &shapes, ifstream &in);
 } // namespace detail
 
 void save_appstate(const Shapes &shapes, const std::string &save_file);
-void load_appstate(Shapes &shapes, const std::string &save_file);
+// false if the file does not open, its shapes do not read or an instance
+// group is invalid, shapes is left as it was then
+bool load_appstate(Shapes &shapes, const std::string &save_file);
 } // namespace serialize
@@ -1,48 +1,182 @@
 #include "shapes.hpp"
+#include "spatial.hpp"
+#include "geometry.hpp"
+#include "history.hpp"
+#include "arena.hpp"
+#include "instances.hpp"
+#include "layers.hpp"
+#include "nodes.hpp"
 
 Line *Shapes::get_line_by_id(const int id) {
-	for (auto &line : lines) {
-		if (id == line.id) {
-			return &line;
-		}
+	if (id < 0 || static_cast<size_t>(id) >= by_id.size() ||
+			by_id[id].type != ShapeType::LINE) {
+		return nullptr;
 	}
-	return nullptr;
+	return lines.get(by_id[id].handle);
 }
 Circle *Shapes::get_circle_by_id(const int id) {
-	for (auto &circle : circles) {
-		if (id == circle.id) {
-			return &circle;
-		}
+	if (id < 0 || static_cast<size_t>(id) >= by_id.size() ||
+			by_id[id].type != ShapeType::CIRCLE) {
+		return nullptr;
 	}
-	return nullptr;
+	return circles.get(by_id[id].handle);
 }
 Arc *Shapes::get_arc_by_id(const int id) {
-	for (auto &arc : arcs) {
-		if (id == arc.id) {
-			return &arc;
-		}
+	if (id < 0 || static_cast<size_t>(id) >= by_id.size() ||
+			by_id[id].type != ShapeType::ARC) {
+		return nullptr;
 	}
-	return nullptr;
+	return arcs.get(by_id[id].handle);
 }
 
 Line &Shapes::get_line_by_index(const size_t index) {
-	assert(index <= lines.size());
+	assert(index < lines.size());
 	return lines[index];
 }
 Circle &Shapes::get_circle_by_index(const size_t index) {
-	assert(index <= circles.size());
+	assert(index < circles.size());
 	return circles[index];
 }
 Arc &Shapes::get_arc_by_index(const size_t index) {
-	assert(index <= arcs.size());
+	assert(index < arcs.size());
 	return arcs[index];
 }
 
 namespace shapes {
+namespace detail {
+template <typename T, typename G>
+Handle add(Shapes &shapes, SlotMap<T> &store, G &geom, ShapeType type,
+					 T shape) {
+	if (shape.id < 0) {
+		shape.id = shapes.id_counter++;
+	}
+	size_t id = static_cast<size_t>(shape.id);
+	if (id >= shapes.by_id.size()) {
+		shapes.by_id.resize(id + 1);
+	}
+	geometry::append(geom, shape.geom);
+	history::record(shapes.history, OpKind::ADD, shape);
+	layers::touch(shapes.layers, shape.pflags.layer);
+	Handle handle = store.insert(std::move(shape));
+	shapes.by_id[id] = ShapeSlot{type, handle};
+	shapes.quantity_change = true;
+	return handle;
+}
+
+// the moved last shape changes its dense index, the grid has to be rebuilt
+template <typename T, typename G>
+bool remove(Shapes &shapes, SlotMap<T> &store, G &geom, const Handle &handle,
+						const bool patch_nodes) {
+	size_t index = store.index_of(handle);
+	if (index == store.npos) {
+		return false;
+	}
+	shapes.by_id[store[index].id] = ShapeSlot{};
+	history::record(shapes.history, OpKind::REMOVE, store[index]);
+	layers::touch(shapes.layers, store[index].pflags.layer);
+	store.erase(handle);
+	geometry::swap_remove(geom, index);
+	if (!patch_nodes) {
+		shapes.quantity_change = true;
+	}
+	shapes.grid.built = false;
+	return true;
+}
+} // namespace detail
+
+Handle add_line(Shapes &shapes, Line line) {
+	return detail::add(shapes, shapes.lines, shapes.geometry.lines,
+										 ShapeType::LINE, std::move(line));
+}
+Handle add_circle(Shapes &shapes, Circle circle) {
+	return detail::add(shapes, shapes.circles, shapes.geometry.circles,
+										 ShapeType::CIRCLE, std::move(circle));
+}
+Handle add_arc(Shapes &shapes, Arc arc) {
+	return detail::add(shapes, shapes.arcs, shapes.geometry.arcs,
+										 ShapeType::ARC, std::move(arc));
+}
+int add_batch(Shapes &shapes, ShapeBatch batch) {
+	int first = static_cast<int>(shapes.id_counter);
+	shapes.lines.reserve(shapes.lines.size() + batch.lines.size());
+	shapes.circles.reserve(shapes.circles.size() + batch.circles.size());
+	shapes.arcs.reserve(shapes.arcs.size() + batch.arcs.size());
+	geometry::reserve(shapes.geometry.lines, shapes.lines.size() + batch.lines.size());
+	geometry::reserve(shapes.geometry.circles,
+										shapes.circles.size() + batch.circles.size());
+	geometry::reserve(shapes.geometry.arcs, shapes.arcs.size() + batch.arcs.size());
+	shapes.by_id.reserve(shapes.id_counter + batch.size());
+	for (auto &line : batch.lines) {
+		add_line(shapes, std::move(line));
+	}
+	for (auto &circle : batch.circles) {
+		add_circle(shapes, std::move(circle));
+	}
+	for (auto &arc : batch.arcs) {
+		add_arc(shapes, std::move(arc));
+	}
+	return first;
+}
+bool remove_line(Shapes &shapes, const Handle &handle,
+								 const bool patch_nodes) {
+	return detail::remove(shapes, shapes.lines, shapes.geometry.lines, handle,
+												patch_nodes);
+}
+bool remove_circle(Shapes &shapes, const Handle &handle,
+									 const bool patch_nodes) {
+	return detail::remove(shapes, shapes.circles, shapes.geometry.circles, handle,
+												patch_nodes);
+}
+bool remove_arc(Shapes &shapes, const Handle &handle,
+								const bool patch_nodes) {
+	return detail::remove(shapes, shapes.arcs, shapes.geometry.arcs, handle,
+												patch_nodes);
+}
+
+void toggle_concealed(Shapes &shapes, const ShapeType type, const Handle &handle) {
+	auto toggle = [&](auto &store) {
+		if (auto *shape = store.get(handle)) {
+			util::toggle_bool(shape->pflags.concealed);
+			history::record(shapes.history, OpKind::CONCEAL, *shape);
+			layers::touch(shapes.layers, shape->pflags.layer);
+			// node positions stay, only the nodes of the shape change
+			nodes::refresh_concealed(shapes, shape->id);
+		}
+	};
+	switch (type) {
+	case ShapeType::LINE:   toggle(shapes.lines);   break;
+	case ShapeType::CIRCLE: toggle(shapes.circles); break;
+	case ShapeType::ARC:    toggle(shapes.arcs);    break;
+	default: break;
+	}
+}
+
+// ids start over, handles into the old shapes become stale, nothing to undo
+void clear_all(Shapes &shapes) {
+	shapes.lines.clear();
+	shapes.circles.clear();
+	shapes.arcs.clear();
+	geometry::clear(shapes.geometry);
+	shapes.ixn_points.clear();
+	shapes.def_points.clear();
+	shapes.by_id.clear();
+	shapes.id_counter = 0;
+	shapes.instance_groups.clear();
+	layers::clear(shapes.layers);
+	shapes.ref = Ref{};
+	history::clear(shapes.history);
+	shapes.shape_tflags.clear();
+	shapes.ixn_tflags.clear();
+	shapes.def_tflags.clear();
+	shapes.quantity_change = true;
+	shapes.node_index = NodeIndex{};
+	shapes.grid.built = false;
+}
+
 void print_node_ids(Shapes &shapes) {
 	if (shapes.snap.in_distance) {
 		if (shapes.snap.shape == SnapShape::IXN_POINT) {
-			Node ixn_point = shapes.ixn_points[shapes.snap.index];
+			const Node &ixn_point = shapes.ixn_points[shapes.snap.index];
 			cout << "ixn_point: " << ixn_point.P.x << ", " << ixn_point.P.y << endl;
 			cout << "ids: " << endl;
 			for (auto &id : ixn_point.ids) {
@@ -50,7 +184,7 @@ void print_node_ids(Shapes &shapes) {
 			}
 			cout << endl;
 		} else if (shapes.snap.shape == SnapShape::DEF_POINT) {
-			Node def_point = shapes.def_points[shapes.snap.index];
+			const Node &def_point = shapes.def_points[shapes.snap.index];
 			cout << "def_point: " << def_point.P.x << ", " << def_point.P.y << endl;
 			cout << "ids: " << endl;
 			for (auto &id : def_point.ids) {
@@ -62,40 +196,55 @@ void print_node_ids(Shapes &shapes) {
 }
 
 void toggle_select(App &app, Shapes &shapes) {
-  if (shapes.snap.in_distance && !shapes.snap.is_node_shape) {
-    switch (shapes.snap.shape) {
-    case SnapShape::LINE:
-      util::toggle_bool(
-          shapes.get_line_by_index(shapes.snap.index).tflags.selected);
-      break;
-    case SnapShape::CIRCLE:
-      util::toggle_bool(
-          shapes.get_circle_by_index(shapes.snap.index).tflags.selected);
-      break;
-    case SnapShape::ARC:
-      util::toggle_bool(
-          shapes.get_arc_by_index(shapes.snap.index).tflags.selected);
-      break;
-    default:
-      exit(EXIT_FAILURE);
-    }
-  }
+	if (shapes.snap.in_distance && !shapes.snap.is_node_shape) {
+		const Shape *shape = nullptr;
+		switch (shapes.snap.shape) {
+		case SnapShape::LINE:
+			shape = shapes.lines.get(shapes.snap.handle);
+			break;
+		case SnapShape::CIRCLE:
+			shape = shapes.circles.get(shapes.snap.handle);
+			break;
+		case SnapShape::ARC:
+			shape = shapes.arcs.get(shapes.snap.handle);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+		// frozen layers are locked
+		if (shape && !layers::frozen(shapes.layers, shape->pflags.layer)) {
+			shapes.shape_tflags.selected.toggle(shape->id);
+		}
+	}
 }
 
+// the selection is collected as handles first, erasing moves shapes in
+// the dense stores but their handles stay valid. the nodes lose the ids
+// instead of being rebuilt
 void pop_selected(Shapes &shapes) {
-  shapes.lines.erase(
-      remove_if(shapes.lines.begin(), shapes.lines.end(),
-                [](const Line &line) { return line.tflags.selected; }),
-      shapes.lines.end());
-  shapes.circles.erase(
-      remove_if(shapes.circles.begin(), shapes.circles.end(),
-                [](const Circle &circle) { return circle.tflags.selected; }),
-      shapes.circles.end());
-  shapes.arcs.erase(
-      remove_if(shapes.arcs.begin(), shapes.arcs.end(),
-                [](const Arc &arc) { return arc.tflags.selected; }),
-      shapes.arcs.end());
-  shapes.quantity_change = true;
+	std::vector<Handle> lines, circles, arcs;
+	std::vector<int> ids;
+	auto collect = [&](auto &store, std::vector<Handle> &handles) {
+		for (size_t i = 0; i < store.size(); i++) {
+			if (shapes.shape_tflags.selected.test(store[i].id)) {
+				handles.push_back(store.handle_at(i));
+				ids.push_back(store[i].id);
+			}
+		}
+	};
+	collect(shapes.lines, lines);
+	collect(shapes.circles, circles);
+	collect(shapes.arcs, arcs);
+	if (ids.empty()) {
+		return;
+	}
+	for (auto &handle : lines) { remove_line(shapes, handle, true); }
+	for (auto &handle : circles) { remove_circle(shapes, handle, true); }
+	for (auto &handle : arcs) { remove_arc(shapes, handle, true); }
+	for (int id : ids) {
+		shapes.shape_tflags.selected.set(id, false);
+	}
+	nodes::remove_shapes(shapes, ids);
 }
 
 void pop_by_id(int id);
@@ -121,9 +270,8 @@ void construct_line(const App &app, Shapes &shapes, const Vec2 &P) {
 				line.geom.B = P;
 			}
 			line.pflags.concealed = construct.concealed;
-			line.id = shapes.id_counter++;
-			shapes.lines.push_back(line);
-			shapes.quantity_change = true;
+			line.pflags.layer = shapes.layers.active;
+			shapes::add_line(shapes, line);
 			construct.clear();
 		}
 	} else if (construct.point_set == PointSet::FIRST) {
@@ -164,9 +312,8 @@ void construct_circle(const App &app, Shapes &shapes, const Vec2 &P) {
 			set_P(shapes, circle.geom, P);
 
 			circle.pflags.concealed = construct.concealed;
-			circle.id = shapes.id_counter++;
-			shapes.circles.push_back(circle);
-			shapes.quantity_change = true;
+			circle.pflags.layer = shapes.layers.active;
+			shapes::add_circle(shapes, circle);
 			construct.clear();
 		}
 	} else if (shapes.construct.point_set == PointSet::FIRST) {
@@ -175,7 +322,7 @@ void construct_circle(const App &app, Shapes &shapes, const Vec2 &P) {
 }
 
 // arc NOTE use angle instead of distance to make better
-void set_snap_E(std::vector<Vec2> ixn_points, const App &app, Arc &arc) {
+void set_snap_E(const IxnPoints &ixn_points, const App &app, Arc &arc) {
 	if (ixn_points.size() == 2) {
 		if (vec2::distance(ixn_points.at(0), app.input.mouse) < 
 				vec2::distance(ixn_points.at(1), app.input.mouse)) {
@@ -190,25 +337,25 @@ void set_snap_E(std::vector<Vec2> ixn_points, const App &app, Arc &arc) {
 
 void set_E(const App &app, Shapes &shapes, Arc &arc, const Vec2 &P) {
 	if (shapes.snap.in_distance && !shapes.snap.is_node_shape) {
-		if (shapes.snap.shape == SnapShape::LINE) {
-			Line &line = shapes.get_line_by_index(shapes.snap.index);
-			std::vector<Vec2> ixn_points = graphics::Line2_Circle2_intersect(line.geom, arc.geom.to_circle());
+		Line *line = shapes.lines.get(shapes.snap.handle);
+		Circle *circle = shapes.circles.get(shapes.snap.handle);
+		Arc *arc_2 = shapes.arcs.get(shapes.snap.handle);
+		if (shapes.snap.shape == SnapShape::LINE && line) {
+			IxnPoints ixn_points = graphics::Line2_Circle2_intersect(line->geom, arc.geom.to_circle());
 			if (ixn_points.size() != 0) {
 				set_snap_E(ixn_points, app, arc);
 			} else {
 				arc.geom.E = circle2::project_point(arc.geom.to_circle(), P);
 			}
-		} else if (shapes.snap.shape == SnapShape::CIRCLE) {
-			Circle &circle = shapes.get_circle_by_index(shapes.snap.index);
-			std::vector<Vec2> ixn_points = graphics::Circle2_Circle2_intersect(arc.geom.to_circle(), circle.geom);
+		} else if (shapes.snap.shape == SnapShape::CIRCLE && circle) {
+			IxnPoints ixn_points = graphics::Circle2_Circle2_intersect(arc.geom.to_circle(), circle->geom);
 			if (ixn_points.size() != 0) {
 				set_snap_E(ixn_points, app, arc);
 			} else {
 				arc.geom.E = circle2::project_point(arc.geom.to_circle(), P);
 			}
-		} else if (shapes.snap.shape == SnapShape::ARC) {
-			Arc &arc_2 = shapes.get_arc_by_index(shapes.snap.index);
-			std::vector<Vec2> ixn_points = graphics::Arc2_Circle2_intersect(arc_2.geom, arc.geom.to_circle());
+		} else if (shapes.snap.shape == SnapShape::ARC && arc_2) {
+			IxnPoints ixn_points = graphics::Arc2_Circle2_intersect(arc_2->geom, arc.geom.to_circle());
 			if (ixn_points.size() != 0) {
 				set_snap_E(ixn_points, app, arc);
 			} else {
@@ -251,9 +398,8 @@ void construct_arc(const App &app, Shapes &shapes, Vec2 const &P) {
 		} else if (shapes.construct.point_set == PointSet::SECOND) {
 			set_E(app, shapes, arc, P);
 			arc.pflags.concealed = construct.concealed;
-			arc.id = shapes.id_counter++;
-			shapes.arcs.push_back(arc);
-			shapes.quantity_change = true;
+			arc.pflags.layer = shapes.layers.active;
+			shapes::add_arc(shapes, arc);
 			construct.clear();
 		}
 	} else if (shapes.construct.point_set == PointSet::FIRST) {
@@ -277,160 +423,201 @@ void construct(const App &app, Shapes &shapes, Vec2 const &P) {
 bool update_snap(const App &app, Shapes &shapes) {
 	auto &snap = shapes.snap;
 	snap.index = shapes.snap.index_unset;
+	snap.handle = Handle{};
 	snap.id = -1;
 	snap.point = {};
 	snap.in_distance = false;
 	snap.is_node_shape = false;
 	snap.shape = SnapShape::NONE;
 
-	if (snap.enabled_for_node_shapes) {
-		for (size_t index = 0; index < shapes.ixn_points.size(); index++) {
-			if (vec2::distance(shapes.ixn_points[index].P, app.input.mouse) < snap.distance) {
+	// snap distance is given in screen pixels
+	const double distance = snap.distance / app.camera.zoom;
+	const Vec2 &mouse = app.input.mouse;
+
+	// candidates come sorted ixn_points, def_points, lines, circles, arcs
+	std::pmr::vector<GridEntry> candidates{arena::frame()};
+	if (shapes.grid.built) {
+		spatial::query(shapes.grid, Box{mouse - Vec2{distance, distance},
+										mouse + Vec2{distance, distance}}, candidates);
+	} else {
+		spatial::collect_all(shapes, candidates);
+	}
+
+	for (auto [type, index] : candidates) {
+		switch (type) {
+		case ShapeType::IXN_POINT:
+			if (snap.enabled_for_node_shapes && index < shapes.ixn_points.size() &&
+					vec2::distance(shapes.ixn_points[index].P, mouse) < distance) {
 				snap.point = shapes.ixn_points[index].P;
 				snap.shape = SnapShape::IXN_POINT;
 				snap.is_node_shape = true;
 				snap.index = index;
 				snap.id = shapes.ixn_points[index].id;
 				return true;
-			}	
-		}
-
-		for (size_t index = 0; index < shapes.def_points.size(); index++) {
-			if (vec2::distance(shapes.def_points[index].P, app.input.mouse) < snap.distance) {
+			}
+			break;
+		case ShapeType::DEF_POINT:
+			if (snap.enabled_for_node_shapes && index < shapes.def_points.size() &&
+					vec2::distance(shapes.def_points[index].P, mouse) < distance) {
 				snap.point = shapes.def_points[index].P;
 				snap.shape = SnapShape::DEF_POINT;
 				snap.is_node_shape = true;
 				snap.index = index;
 				snap.id = shapes.def_points[index].id;
 				return true;
-			}	
-		}
-	}
-
-	for (size_t index = 0; index < shapes.lines.size(); index++) {
-		Line &line = shapes.lines[index];
-
-		if (line2::get_distance_point_to_seg(line.geom, app.input.mouse) < snap.distance) {
-			Vec2 projected_point = line2::project_point(line.geom, app.input.mouse);
-			if (line2::point_in_segment_bounds(line.geom, projected_point)) {
-				snap.point = projected_point;
+			}
+			break;
+		case ShapeType::LINE: {
+			if (index >= shapes.lines.size()) { break; }
+			Line &line = shapes.lines[index];
+			if (!layers::visible(shapes.layers, line.pflags.layer)) { break; }
+			if (line2::get_distance_point_to_seg(line.geom, mouse) < distance) {
+				Vec2 projected_point = line2::project_point(line.geom, mouse);
+				if (line2::point_in_segment_bounds(line.geom, projected_point)) {
+					snap.point = projected_point;
+				} else if (vec2::distance(mouse, line.geom.A) < distance) {
+					snap.point = line.geom.A;
+				} else if (vec2::distance(mouse, line.geom.B) < distance) {
+					snap.point = line.geom.B;
+				} else {
+					break;
+				}
 				snap.shape = SnapShape::LINE;
 				snap.is_node_shape = false;
 				snap.index = index;
-				snap.id = shapes.lines[index].id;
+				snap.handle = shapes.lines.handle_at(index);
+				snap.id = line.id;
 				return true;
-			} else if (vec2::distance(app.input.mouse, line.geom.A) < snap.distance) {
-				snap.point = line.geom.A;
-				snap.shape = SnapShape::LINE;
+			}
+			break;
+		}
+		case ShapeType::CIRCLE: {
+			if (index >= shapes.circles.size()) { break; }
+			Circle &circle = shapes.circles[index];
+			if (!layers::visible(shapes.layers, circle.pflags.layer)) { break; }
+			double center_distance = vec2::distance(circle.geom.C, mouse);
+			if (center_distance < circle.geom.radius() + distance &&
+					center_distance > circle.geom.radius() - distance) {
+				snap.point = circle2::project_point(circle.geom, mouse);
+				snap.shape = SnapShape::CIRCLE;
 				snap.is_node_shape = false;
 				snap.index = index;
-				snap.id = shapes.lines[index].id;
+				snap.handle = shapes.circles.handle_at(index);
+				snap.id = circle.id;
 				return true;
-			} else if (vec2::distance(app.input.mouse, line.geom.B) < snap.distance) {
-				snap.point = line.geom.B;
-				snap.shape = SnapShape::LINE;
+			}
+			break;
+		}
+		case ShapeType::ARC: {
+			if (index >= shapes.arcs.size()) { break; }
+			Arc &arc = shapes.arcs[index];
+			if (!layers::visible(shapes.layers, arc.pflags.layer)) { break; }
+			double center_distance = vec2::distance(arc.geom.C, mouse);
+			if (center_distance < arc.geom.radius() + distance &&
+					center_distance > arc.geom.radius() - distance &&
+					arc2::angle_on_arc(arc.geom, circle2::get_angle_of_point(
+						arc.geom.to_circle(), mouse))) {
+				snap.point = circle2::project_point(arc.geom.to_circle(), mouse);
+				snap.shape = SnapShape::ARC;
 				snap.is_node_shape = false;
 				snap.index = index;
-				snap.id = shapes.lines[index].id;
+				snap.handle = shapes.arcs.handle_at(index);
+				snap.id = arc.id;
 				return true;
 			}
+			break;
 		}
-	}
-
-	for (size_t index = 0; index < shapes.circles.size(); index++) {
-		Circle &circle = shapes.circles[index];
-		double distance = vec2::distance(circle.geom.C, app.input.mouse);
-		if (distance < circle.geom.radius() + snap.distance &&
-				distance > circle.geom.radius() - snap.distance) {
-			snap.point = circle2::project_point(circle.geom, app.input.mouse);
-			snap.shape = SnapShape::CIRCLE;
-			snap.is_node_shape = false;
-			snap.index = index;
-			snap.id = shapes.circles[index].id;
-			return true;
+		default:
+			break;
 		}
 	}
 
-	for (size_t index = 0; index < shapes.arcs.size(); index++) {
-		Arc &arc = shapes.arcs[index];
-		double distance = vec2::distance(arc.geom.C, app.input.mouse);
-		if (distance < arc.geom.radius() + snap.distance &&
-				distance > arc.geom.radius() - snap.distance) {
-			if (arc2::angle_on_arc(arc.geom, circle2::get_angle_of_point(
-					arc.geom.to_circle(), app.input.mouse))) {
-			snap.point = circle2::project_point(arc.geom.to_circle(), app.input.mouse);
-			snap.shape = SnapShape::ARC;
-			snap.is_node_shape = false;
-			snap.index = index;
-			snap.id = shapes.arcs[index].id;
-			return true;
+	// instance copies are not in the grid, they come after stored shapes
+	if (!shapes.instance_groups.empty()) {
+		std::pmr::vector<Instance> copies{arena::frame()};
+		instances::expand(shapes, copies);
+		for (const Instance &copy : copies) {
+			if (layers::visible(shapes.layers, copy.layer) &&
+					instances::snap_point(copy, mouse, distance, snap.point)) {
+				snap.shape = copy.type == ShapeType::LINE ? SnapShape::LINE :
+					copy.type == ShapeType::CIRCLE ? SnapShape::CIRCLE : SnapShape::ARC;
+				snap.is_node_shape = false;
+				return true;
 			}
 		}
 	}
 	return false;
 }
 
-void maybe_append_node(std::vector<Node> &nodes, Vec2 &P,
+size_t maybe_append_node(std::vector<Node> &nodes, Vec2 &P,
                            int shape_id, bool node_concealed) {
   bool is_duplicate = false;
   for (auto &node : nodes) {
 		if (vec2::equal_int_epsilon(node.P, P)) {
       is_duplicate = true;
+			size_t index = static_cast<size_t>(&node - nodes.data());
+			// maybe change conceal status of id point, also when the id is
+			// in it already
+			if (node.pflags.concealed && !node_concealed) {
+				node.pflags.concealed = false;
+			}
 			// test if id allready in node
       for (auto &id : node.ids) {
 				if (shape_id == id) {
-					return;
+					return index;
         }
       }
-			// add id to id point, maybe change conceal status of id point
-			if (node.pflags.concealed && !node_concealed) {
-				node.pflags.concealed = false;
+			// add id to id point, no id for points of instance copies
+			if (shape_id >= 0) {
+				node.ids.push_back(shape_id);
 			}
-      node.ids.push_back(shape_id);
-			return;
+			return index;
     }
   }
 	if (!is_duplicate) {
 		// create the node
 		nodes.push_back(Node{shape_id, P});
 		// push back the shape id
-		nodes.back().ids.push_back(shape_id);
+		if (shape_id >= 0) {
+			nodes.back().ids.push_back(shape_id);
+		}
 		if (node_concealed) {
 			nodes.back().pflags.concealed = true;
 		}
   }
+	return nodes.size() - 1;
 }
 
 void maybe_select_ref(App &app, Shapes &shapes) {
 	if (app.input.ctrl_set) {
-		if (shapes.snap.shape == SnapShape::LINE) {
-			auto &line = shapes.get_line_by_index(shapes.snap.index);
-			if (shapes.ref.id == line.id) {
+		Line *line = shapes.lines.get(shapes.snap.handle);
+		Circle *circle = shapes.circles.get(shapes.snap.handle);
+		Arc *arc = shapes.arcs.get(shapes.snap.handle);
+		if (shapes.snap.shape == SnapShape::LINE && line) {
+			if (shapes.ref.id == line->id) {
 				shapes.ref.shape = RefShape::NONE;
 			} else {
 				shapes.ref.shape = RefShape::LINE;
-				shapes.ref.value = line.geom.length();
-				shapes.ref.id = line.id;
+				shapes.ref.value = line->geom.length();
+				shapes.ref.id = line->id;
 			}
 		}
-		if (shapes.snap.shape == SnapShape::CIRCLE) {
-			auto &circle = shapes.get_circle_by_index(shapes.snap.index);
-			if (shapes.ref.id == circle.id) {
+		if (shapes.snap.shape == SnapShape::CIRCLE && circle) {
+			if (shapes.ref.id == circle->id) {
 				shapes.ref.shape = RefShape::NONE;
 			} else {
 				shapes.ref.shape = RefShape::CIRCLE;
-				shapes.ref.value = circle.geom.radius();
-				shapes.ref.id = circle.id;
+				shapes.ref.value = circle->geom.radius();
+				shapes.ref.id = circle->id;
 			}
 		}
-		if (shapes.snap.shape == SnapShape::ARC) {
-			auto &arc = shapes.get_arc_by_index(shapes.snap.index);
-			if (shapes.ref.id == arc.id) {
+		if (shapes.snap.shape == SnapShape::ARC && arc) {
+			if (shapes.ref.id == arc->id) {
 				shapes.ref.shape = RefShape::NONE;
 			} else {
 				shapes.ref.shape = RefShape::ARC;
-				shapes.ref.value = arc.geom.radius();
-				shapes.ref.id = arc.id;
+				shapes.ref.value = arc->geom.radius();
+				shapes.ref.id = arc->id;
 			}
 		}
 	}
@@ -438,12 +625,16 @@ void maybe_select_ref(App &app, Shapes &shapes) {
 
 void clear_edit(Shapes &shapes) {
 	if (shapes.edit.in_edit) {
+		// the shape goes back unchanged, the edit leaves no history
 		if (shapes.edit.shape == EditShape::LINE) {
-			shapes.lines.push_back(shapes.edit.line);
+			add_line(shapes, shapes.edit.line);
+			history::forget(shapes.history, shapes.edit.line.id);
 		} else if (shapes.edit.shape == EditShape::CIRCLE) {
-			shapes.circles.push_back(shapes.edit.circle);
+			add_circle(shapes, shapes.edit.circle);
+			history::forget(shapes.history, shapes.edit.circle.id);
 		} else if (shapes.edit.shape == EditShape::ARC) {
-			shapes.arcs.push_back(shapes.edit.arc);
+			add_arc(shapes, shapes.edit.arc);
+			history::forget(shapes.history, shapes.edit.arc.id);
 		}
 	}
 	shapes.edit.in_edit = false;
@@ -476,39 +667,45 @@ void update_edit(const App &app, Shapes &shapes) {
 	if (!shapes.edit.in_edit) {
 		shapes.snap.enabled_for_node_shapes = false;
 		if (app.input.mouse_click) {
-			if (shapes.snap.shape == SnapShape::LINE) {
-				auto &line = shapes.get_line_by_index(shapes.snap.index);
+			Line *line = shapes.lines.get(shapes.snap.handle);
+			Circle *circle = shapes.circles.get(shapes.snap.handle);
+			Arc *arc = shapes.arcs.get(shapes.snap.handle);
+			// frozen layers are locked
+			const Shape *snapped =
+				shapes.snap.shape == SnapShape::LINE ? static_cast<const Shape *>(line) :
+				shapes.snap.shape == SnapShape::CIRCLE ? static_cast<const Shape *>(circle) :
+				shapes.snap.shape == SnapShape::ARC ? static_cast<const Shape *>(arc) : nullptr;
+			if (snapped && layers::frozen(shapes.layers, snapped->pflags.layer)) {
+				return;
+			}
+			// the shape is taken out of the store while it is edited and
+			// added back with the same id
+			if (shapes.snap.shape == SnapShape::LINE && line) {
 				if (app.input.ctrl_set) {
-					util::toggle_bool(line.pflags.concealed);
-					shapes.quantity_change = true;
+					toggle_concealed(shapes, ShapeType::LINE, shapes.snap.handle);
 				} else {
-					shapes.edit.line = line;
+					shapes.edit.line = *line;
 					shapes.edit.in_edit = true;
 					shapes.edit.shape = EditShape::LINE;
-					shapes.lines.erase(shapes.lines.begin() + shapes.snap.index);
+					remove_line(shapes, shapes.snap.handle);
 				}
-			} else if (shapes.snap.shape == SnapShape::CIRCLE) {
-				auto &circle = shapes.get_circle_by_index(shapes.snap.index);
+			} else if (shapes.snap.shape == SnapShape::CIRCLE && circle) {
 				if (app.input.ctrl_set) {
-					assert(shapes.snap.index <= shapes.circles.size());
-					util::toggle_bool(circle.pflags.concealed);
-					shapes.quantity_change = true;
+					toggle_concealed(shapes, ShapeType::CIRCLE, shapes.snap.handle);
 				} else {
-					shapes.edit.circle = circle;
+					shapes.edit.circle = *circle;
 					shapes.edit.in_edit = true;
 					shapes.edit.shape = EditShape::CIRCLE;
-					shapes.circles.erase(shapes.circles.begin() + shapes.snap.index);
+					remove_circle(shapes, shapes.snap.handle);
 				}
-			} else if (shapes.snap.shape == SnapShape::ARC) {
-				auto &arc = shapes.get_arc_by_index(shapes.snap.index);
+			} else if (shapes.snap.shape == SnapShape::ARC && arc) {
 				if (app.input.ctrl_set) {
-					util::toggle_bool(arc.pflags.concealed);
-					shapes.quantity_change = true;
+					toggle_concealed(shapes, ShapeType::ARC, shapes.snap.handle);
 				} else {
-					shapes.edit.arc = arc;
+					shapes.edit.arc = *arc;
 					shapes.edit.in_edit = true;
 					shapes.edit.shape = EditShape::ARC;
-					shapes.arcs.erase(shapes.arcs.begin() + shapes.snap.index);
+					remove_arc(shapes, shapes.snap.handle);
 				}
 			}
 		}
@@ -517,20 +714,17 @@ void update_edit(const App &app, Shapes &shapes) {
 		if (app.input.mouse_click) {
 			if (shapes.edit.shape == EditShape::LINE) {
 				line_edit_update(app, shapes);
-				shapes.lines.push_back(shapes.edit.line);
-				shapes.quantity_change = true;
+				add_line(shapes, shapes.edit.line);
 				shapes.edit.in_edit = false;
 			}
 			if (shapes.edit.shape == EditShape::CIRCLE) {
 				circle_edit_update(app, shapes);
-				shapes.circles.push_back(shapes.edit.circle);
-				shapes.quantity_change = true;
+				add_circle(shapes, shapes.edit.circle);
 				shapes.edit.in_edit = false;
 			}
 			if (shapes.edit.shape == EditShape::ARC) {
 				arc_edit_update(app, shapes);
-				shapes.arcs.push_back(shapes.edit.arc);
-				shapes.quantity_change = true;
+				add_arc(shapes, shapes.edit.arc);
 				shapes.edit.in_edit = false;
 			}
 		} else {
@@ -548,35 +742,27 @@ void update_edit(const App &app, Shapes &shapes) {
 }
 
 void clear_tflags_global(Shapes &shapes) {
-	for (auto &ixn_point: shapes.ixn_points) { ixn_point.clear_tflags(); }
-	for (auto &def_point : shapes.def_points) { def_point.clear_tflags(); }
-	for (auto &line: shapes.lines) { line.clear_tflags(); }
-	for (auto &circle: shapes.circles) { circle.clear_tflags(); }
-	for (auto &arc: shapes.arcs) { arc.clear_tflags(); }
+	shapes.shape_tflags.clear();
+	shapes.ixn_tflags.clear();
+	shapes.def_tflags.clear();
 }
 
 void clear_tflags_hl_primary_global(Shapes &shapes) {
-	for (auto &ixn_point: shapes.ixn_points) { ixn_point.tflags.hl_primary = false; }
-	for (auto &def_point : shapes.def_points) { def_point.tflags.hl_primary = false; }
-	for (auto &line: shapes.lines) { line.tflags.hl_primary = false; }
-	for (auto &circle: shapes.circles) { circle.tflags.hl_primary = false; }
-	for (auto &arc: shapes.arcs) { arc.tflags.hl_primary = false; }
+	shapes.shape_tflags.hl_primary.clear();
+	shapes.ixn_tflags.hl_primary.clear();
+	shapes.def_tflags.hl_primary.clear();
 }
 
 void clear_tflags_hl_secondary_global(Shapes &shapes) {
-	for (auto &ixn_point: shapes.ixn_points) { ixn_point.tflags.hl_secondary = false; }
-	for (auto &def_point : shapes.def_points) { def_point.tflags.hl_secondary = false; }
-	for (auto &line: shapes.lines) { line.tflags.hl_secondary = false; }
-	for (auto &circle: shapes.circles) { circle.tflags.hl_secondary = false; }
-	for (auto &arc: shapes.arcs) { arc.tflags.hl_secondary = false; }
+	shapes.shape_tflags.hl_secondary.clear();
+	shapes.ixn_tflags.hl_secondary.clear();
+	shapes.def_tflags.hl_secondary.clear();
 }
 
 void clear_tflags_hl_tertiary_global(Shapes &shapes) {
-	for (auto &ixn_point: shapes.ixn_points) { ixn_point.tflags.hl_tertiary = false; }
-	for (auto &def_point : shapes.def_points) { def_point.tflags.hl_tertiary = false; }
-	for (auto &line: shapes.lines) { line.tflags.hl_tertiary = false; }
-	for (auto &circle: shapes.circles) { circle.tflags.hl_tertiary = false; }
-	for (auto &arc: shapes.arcs) { arc.tflags.hl_tertiary = false; }
+	shapes.shape_tflags.hl_tertiary.clear();
+	shapes.ixn_tflags.hl_tertiary.clear();
+	shapes.def_tflags.hl_tertiary.clear();
 }
 
 bool id_match(const std::vector<int> &ids, const int shape_id) {
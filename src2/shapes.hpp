@@ -3,44 +3,69 @@
 #include "core.hpp"
 #include "graphics.hpp"
 #include "app.hpp"
+#include "slotmap.hpp"
+
+// one bit per shape id or node index, clearing is a memset over the words
+struct FlagBits {
+	std::vector<uint64_t> words;
+	bool test(const size_t i) const {
+		size_t word = i >> 6;
+		return word < words.size() && ((words[word] >> (i & 63)) & 1);
+	}
+	void set(const size_t i, const bool value = true) {
+		size_t word = i >> 6;
+		if (word >= words.size()) {
+			if (!value) { return; }
+			words.resize(word + 1);
+		}
+		uint64_t bit = uint64_t{1} << (i & 63);
+		words[word] = value ? words[word] | bit : words[word] & ~bit;
+	}
+	void toggle(const size_t i) {
+		set(i, !test(i));
+	}
+	void clear() {
+		if (!words.empty()) {
+			std::memset(words.data(), 0, words.size() * sizeof(uint64_t));
+		}
+	}
+};
 
 // these flags can be reset when changing modes or pressing escape
 struct TemporaryFlags {
-	bool selected{false};
-	bool hl_primary{false};
-	bool hl_secondary{false};
-	bool hl_tertiary{false};
+	FlagBits selected;
+	FlagBits hl_primary;
+	FlagBits hl_secondary;
+	FlagBits hl_tertiary;
+	void clear() {
+		selected.clear();
+		clear_hl();
+	}
+	void clear_hl() {
+		hl_primary.clear();
+		hl_secondary.clear();
+		hl_tertiary.clear();
+	}
+	bool highlighted(const size_t i) const {
+		return hl_primary.test(i) || hl_secondary.test(i) || hl_tertiary.test(i);
+	}
 };
 
 // these flags are guaranteed to be persitent when changing modes
 struct PersistentFlags {
 	bool concealed{false};
+	uint8_t layer{0};
 };
 
 enum struct ShapeType { NONE, IXN_POINT, DEF_POINT, LINE, CIRCLE, ARC };
 struct Shape {
 	int id{-1};
-	TemporaryFlags tflags;
 	PersistentFlags pflags;
 	Shape() = default;
 	Shape(const int id) : id{id} {}
-	void clear_tflags() {
-		tflags.selected = false;
-		tflags.hl_primary = false;
-		tflags.hl_secondary = false;
-		tflags.hl_tertiary = false;
-	}
 	void clear_pflags() {
 		pflags.concealed = false;
 	}
-	void clear_hl() {
-		tflags.hl_primary = false;
-		tflags.hl_secondary = false;
-		tflags.hl_tertiary = false;
-	}
-	bool highlighted() {
-		return tflags.hl_primary || tflags.hl_secondary || tflags.hl_tertiary;
-	}
 };
 
 struct Node: Shape {
@@ -51,6 +76,17 @@ struct Node: Shape {
 		: Shape{id}, P{P} {}
 };
 
+// one intersection point of a pair, merged into the nodes in the order
+// the serial loops would have found it
+struct IxnRecord {
+	Vec2 P{};
+	int id_a {-1};
+	int id_b {-1};
+	bool concealed = false;
+	// both shapes are in this frozen layer, -1 otherwise
+	int layer {-1};
+};
+
 struct Line: Shape {
 	Line2 geom{};
 	Line() = default;
@@ -115,6 +151,8 @@ struct Snap {
 
 	static constexpr size_t index_unset = std::numeric_limits<size_t>::max();
 	size_t index {index_unset};
+	// set for lines, circles and arcs, index is only valid this frame
+	Handle handle {};
 	int id {-1};
 	bool is_node_shape = false;
 	bool in_distance = false;
@@ -122,14 +160,168 @@ struct Snap {
 	Vec2 point;
 };
 
-struct Shapes {
+// uniform grid over shape and node bounds for view culling and snapping
+struct GridEntry {
+	ShapeType type = ShapeType::NONE;
+	uint32_t index = 0;
+};
+struct ShapeGrid {
+	static constexpr double cell_size = 64.0;
+	// entries spanning more cells are kept in a flat list instead
+	static constexpr size_t max_cells_per_entry = 256;
+	std::unordered_map<uint64_t, std::vector<GridEntry>> cells;
+	std::vector<GridEntry> oversized;
+	bool built = false;
+};
+
+// where ixn node lies on a shape: t of the projection from A (0) to B (1)
+// on a line, the angle of circle2::get_angle_of_point on a circle or arc
+struct NodeParam {
+	double value = 0.0;
+	uint32_t node = 0;
+};
+
+// which shapes made which nodes, kept next to ixn_points and def_points
+// by nodes::. ixn_pairs has one entry per ixn node with the id pairs whose
+// intersection merged into it, ixn and def list the node indices of every
+// shape id. revision of a shape id goes up whenever its ixn nodes may have
+// changed, a result cached for the shape is current while it is the same.
+// params holds the ixn nodes of every shape id once more, ordered along
+// the shape, so relations are read off without measuring or sorting
+struct NodeIndex {
+	std::vector<std::vector<std::pair<int, int>>> ixn_pairs;
+	std::vector<std::vector<uint32_t>> ixn;
+	std::vector<std::vector<uint32_t>> def;
+	std::vector<std::vector<NodeParam>> params;
+	std::vector<uint32_t> revision;
+	bool built = false;
+};
+
+// coordinates only, one entry per shape in the same dense order as the
+// slot map of that type, for kernels that don't need the flags
+struct LineGeometry {
+	std::vector<double> ax, ay, bx, by;
+};
+struct CircleGeometry {
+	std::vector<double> cx, cy, r;
+};
+struct ArcGeometry {
+	std::vector<double> cx, cy, r;
+	std::vector<double> sx, sy, ex, ey;
+};
+struct Geometry {
+	LineGeometry lines;
+	CircleGeometry circles;
+	ArcGeometry arcs;
+};
+
+// undo history, an operation log over shape ids. shape values in the log
+// are immutable and shared between ops, an op is the only copy made, so
+// memory grows with the number of edits and not with the scene
+enum struct OpKind { ADD, REMOVE, CONCEAL };
+struct ShapeValue {
+	ShapeType type = ShapeType::NONE;
+	Line line {};
+	Circle circle {};
+	Arc arc {};
+};
+struct Op {
+	OpKind kind = OpKind::ADD;
+	int id {-1};
+	std::shared_ptr<const ShapeValue> value;
+};
+// everything one user action changed, undone and redone as a unit
+struct Action {
+	std::vector<Op> ops;
+};
+struct History {
+	static constexpr size_t max_actions = 1024;
+	std::deque<Action> undo;
+	std::vector<Action> redo;
+	Action pending;
+	// last recorded value per id, lets a remove share the value of its add
+	std::unordered_map<int, std::shared_ptr<const ShapeValue>> latest;
+	// set while undo/redo replays ops so they are not recorded again
+	bool replaying = false;
+};
+
+// where the shape with a given id is stored
+struct ShapeSlot {
+	ShapeType type = ShapeType::NONE;
+	Handle handle {};
+};
+
+// every shape is in one layer. a layer pair only gets intersection nodes
+// while its policy bit is set. hidden layers are not drawn or snapped but
+// still give nodes, frozen layers are locked and keep their nodes and
+// raster cached until a shape in them changes
+struct Layer {
+	bool visible = true;
+	bool frozen = false;
+	// bumped whenever a shape of the layer is added, removed or changed
+	uint64_t revision = 0;
+	// intersections among the shapes of the layer while frozen
+	bool nodes_cached = false;
+	uint64_t nodes_revision = 0;
+	std::vector<IxnRecord> node_records;
+};
+struct Layers {
+	static constexpr size_t max_layers = 16;
+	std::vector<Layer> layers = std::vector<Layer>(1);
+	// bit j of intersects[i] is set if layers i and j intersect
+	std::array<uint16_t, max_layers> intersects = [] {
+		std::array<uint16_t, max_layers> all{};
+		all.fill(0xFFFF);
+		return all;
+	}();
+	// new shapes go here
+	uint8_t active = 0;
+};
+
+// rigid motion P' = M P + t, mirrors have det M = -1
+struct Isometry {
+	double m00 = 1.0, m01 = 0.0;
+	double m10 = 0.0, m11 = 1.0;
+	Vec2 t{};
+	bool mirrors() const { return m00 * m11 - m01 * m10 < 0.0; }
+};
+
+// symmetric copies of a set of base shapes, only the base shapes are
+// stored. transforms is the whole symmetry group with the identity first,
+// so it is closed under composition and inverse[k] is again one of them
+enum struct InstanceKind { ROTATION, MIRROR };
+struct InstanceGroup {
+	static constexpr int default_fold = 12;
+	InstanceKind kind = InstanceKind::ROTATION;
+	std::vector<int> base_ids;
+	// rotation about pivot in fold steps or mirror across axis
+	Vec2 pivot{};
+	int fold = default_fold;
+	Line2 axis{};
+	std::vector<Isometry> transforms;
+	std::vector<uint32_t> inverse;
+};
+
+// input of shapes::add_batch, for importers and generators
+struct ShapeBatch {
 	std::vector<Line> lines;
 	std::vector<Circle> circles;
 	std::vector<Arc> arcs;
+	size_t size() const { return lines.size() + circles.size() + arcs.size(); }
+};
+
+// lines, circles and arcs are only added and removed through the
+// shapes:: functions below, they keep by_id and geometry in sync
+struct Shapes {
+	SlotMap<Line> lines;
+	SlotMap<Circle> circles;
+	SlotMap<Arc> arcs;
 	std::vector<Node> ixn_points;
 	std::vector<Node> def_points;
 
 	uint32_t id_counter {};
+	// indexed by shape id
+	std::vector<ShapeSlot> by_id;
 	bool quantity_change = false;
 	bool recalculate = false;
 
@@ -137,6 +329,18 @@ struct Shapes {
 	Edit edit;
 	Ref ref;
 	Snap snap;
+	ShapeGrid grid;
+	NodeIndex node_index;
+	Geometry geometry;
+	History history;
+	std::vector<InstanceGroup> instance_groups;
+	Layers layers;
+
+	// temporary flags live outside the records, shapes by id, nodes by
+	// index into ixn_points and def_points
+	TemporaryFlags shape_tflags;
+	TemporaryFlags ixn_tflags;
+	TemporaryFlags def_tflags;
 
 	Line *get_line_by_id(const int id);
 	Circle *get_circle_by_id(const int id);
@@ -149,6 +353,25 @@ struct Shapes {
 
 namespace shapes {
 // shapes general
+// shapes without an id get the next one, shapes coming back from edit
+// keep theirs
+Handle add_line(Shapes &shapes, Line line);
+Handle add_circle(Shapes &shapes, Circle circle);
+Handle add_arc(Shapes &shapes, Arc arc);
+// with patch_nodes the caller takes the shape out of the nodes itself and
+// quantity_change is left as it is, the grid is rebuilt either way
+bool remove_line(Shapes &shapes, const Handle &handle,
+								 const bool patch_nodes = false);
+bool remove_circle(Shapes &shapes, const Handle &handle,
+									 const bool patch_nodes = false);
+bool remove_arc(Shapes &shapes, const Handle &handle,
+								const bool patch_nodes = false);
+// many shapes at once, stores grow once and the nodes are rebuilt once
+// at the next frame. shapes without an id get consecutive ids in the
+// order lines, circles, arcs, the first one is returned
+int add_batch(Shapes &shapes, ShapeBatch batch);
+void toggle_concealed(Shapes &shapes, const ShapeType type, const Handle &handle);
+void clear_all(Shapes &shapes);
 
 void pop_selected(Shapes &shapes);
 // void pop_by_id(int id);
@@ -179,7 +402,8 @@ void maybe_select_ref(App &app, Shapes &shapes);
 
 // functions for snapping
 bool update_snap(const App &app, Shapes &shapes);
-void maybe_append_node(std::vector<Node> &nodes, Vec2 &P,
+// index of the node the point went into
+size_t maybe_append_node(std::vector<Node> &nodes, Vec2 &P,
                            int shape_id, bool point_concealed);
 void clear_tflags_global(Shapes &shapes);
 void clear_tflags_hl_primary_global(Shapes &shapes);
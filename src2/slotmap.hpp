@@ -0,0 +1,113 @@
+// slotmap.hpp
+#pragma once
+#include "core.hpp"
+
+// stable reference into a SlotMap, the generation detects reuse of the slot
+struct Handle {
+	static constexpr uint32_t invalid_slot = std::numeric_limits<uint32_t>::max();
+	uint32_t slot = invalid_slot;
+	uint32_t generation = 0;
+	bool valid() const { return slot != invalid_slot; }
+	bool operator==(const Handle &other) const = default;
+};
+
+// values are kept packed in dense for iteration, slots map handles to
+// dense indices. erase moves the last value into the hole, so dense
+// indices are only stable until the next erase, handles stay valid until
+// their own value is erased
+template <typename T>
+struct SlotMap {
+	static constexpr size_t npos = std::numeric_limits<size_t>::max();
+	struct Slot {
+		uint32_t dense_index = 0;
+		uint32_t generation = 0;
+	};
+	std::vector<T> dense;
+	std::vector<uint32_t> dense_to_slot;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> free_slots;
+
+	Handle insert(T value) {
+		uint32_t slot{};
+		if (free_slots.empty()) {
+			slot = static_cast<uint32_t>(slots.size());
+			slots.push_back(Slot{});
+		} else {
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+		slots[slot].dense_index = static_cast<uint32_t>(dense.size());
+		dense.push_back(std::move(value));
+		dense_to_slot.push_back(slot);
+		return Handle{slot, slots[slot].generation};
+	}
+
+	// dense index of the value or npos if the handle is stale
+	size_t index_of(const Handle &handle) const {
+		if (handle.slot >= slots.size() ||
+				slots[handle.slot].generation != handle.generation) {
+			return npos;
+		}
+		return slots[handle.slot].dense_index;
+	}
+	bool contains(const Handle &handle) const {
+		return index_of(handle) != npos;
+	}
+	T *get(const Handle &handle) {
+		size_t index = index_of(handle);
+		return index == npos ? nullptr : &dense[index];
+	}
+	const T *get(const Handle &handle) const {
+		size_t index = index_of(handle);
+		return index == npos ? nullptr : &dense[index];
+	}
+	Handle handle_at(const size_t index) const {
+		assert(index < dense.size());
+		uint32_t slot = dense_to_slot[index];
+		return Handle{slot, slots[slot].generation};
+	}
+
+	bool erase(const Handle &handle) {
+		size_t index = index_of(handle);
+		if (index == npos) {
+			return false;
+		}
+		size_t last = dense.size() - 1;
+		if (index != last) {
+			dense[index] = std::move(dense[last]);
+			dense_to_slot[index] = dense_to_slot[last];
+			slots[dense_to_slot[index]].dense_index = static_cast<uint32_t>(index);
+		}
+		dense.pop_back();
+		dense_to_slot.pop_back();
+		slots[handle.slot].generation++;
+		free_slots.push_back(handle.slot);
+		return true;
+	}
+
+	// every outstanding handle becomes stale
+	void clear() {
+		for (uint32_t slot : dense_to_slot) {
+			slots[slot].generation++;
+			free_slots.push_back(slot);
+		}
+		dense.clear();
+		dense_to_slot.clear();
+	}
+
+	void reserve(const size_t n) {
+		dense.reserve(n);
+		dense_to_slot.reserve(n);
+		slots.reserve(n);
+	}
+
+	size_t size() const { return dense.size(); }
+	bool empty() const { return dense.empty(); }
+	T &operator[](const size_t index) { return dense[index]; }
+	const T &operator[](const size_t index) const { return dense[index]; }
+	T &back() { return dense.back(); }
+	typename std::vector<T>::iterator begin() { return dense.begin(); }
+	typename std::vector<T>::iterator end() { return dense.end(); }
+	typename std::vector<T>::const_iterator begin() const { return dense.begin(); }
+	typename std::vector<T>::const_iterator end() const { return dense.end(); }
+};
@@ -0,0 +1,142 @@
+#include "spatial.hpp"
+
+namespace spatial {
+namespace detail {
+uint64_t cell_key(int64_t cx, int64_t cy) {
+	return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+				 static_cast<uint32_t>(cy);
+}
+
+int64_t cell_of(double v) {
+	return static_cast<int64_t>(std::floor(v / ShapeGrid::cell_size));
+}
+
+void insert(ShapeGrid &grid, const Box &box, GridEntry entry) {
+	int64_t x0 = cell_of(box.min.x), x1 = cell_of(box.max.x);
+	int64_t y0 = cell_of(box.min.y), y1 = cell_of(box.max.y);
+	if (static_cast<size_t>((x1 - x0 + 1) * (y1 - y0 + 1)) >
+			ShapeGrid::max_cells_per_entry) {
+		grid.oversized.push_back(entry);
+		return;
+	}
+	for (int64_t cy = y0; cy <= y1; cy++) {
+		for (int64_t cx = x0; cx <= x1; cx++) {
+			grid.cells[cell_key(cx, cy)].push_back(entry);
+		}
+	}
+}
+} // namespace detail
+
+Box bounds(const Line2 &line) {
+	return Box{{std::min(line.A.x, line.B.x), std::min(line.A.y, line.B.y)},
+						 {std::max(line.A.x, line.B.x), std::max(line.A.y, line.B.y)}};
+}
+Box bounds(const Circle2 &circle) {
+	double r = circle.radius();
+	return Box{{circle.C.x - r, circle.C.y - r}, {circle.C.x + r, circle.C.y + r}};
+}
+Box bounds(const Arc2 &arc) {
+	return bounds(arc.to_circle());
+}
+Box bounds(const Vec2 &P) {
+	return Box{P, P};
+}
+
+bool overlap(const Box &a, const Box &b) {
+	return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+				 a.min.y <= b.max.y && a.max.y >= b.min.y;
+}
+
+bool ring_overlap(const Box &box, const Vec2 &C, double radius) {
+	double nx = std::clamp(C.x, box.min.x, box.max.x);
+	double ny = std::clamp(C.y, box.min.y, box.max.y);
+	double near = vec2::distance(C, Vec2{nx, ny});
+	double fx = std::max(std::abs(C.x - box.min.x), std::abs(C.x - box.max.x));
+	double fy = std::max(std::abs(C.y - box.min.y), std::abs(C.y - box.max.y));
+	double far = std::sqrt(fx * fx + fy * fy);
+	return near <= radius && radius <= far;
+}
+
+void rebuild(ShapeGrid &grid, const Shapes &shapes) {
+	grid.cells.clear();
+	grid.oversized.clear();
+	for (size_t i = 0; i < shapes.lines.size(); i++) {
+		detail::insert(grid, bounds(shapes.lines[i].geom),
+									 GridEntry{ShapeType::LINE, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.circles.size(); i++) {
+		detail::insert(grid, bounds(shapes.circles[i].geom),
+									 GridEntry{ShapeType::CIRCLE, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.arcs.size(); i++) {
+		detail::insert(grid, bounds(shapes.arcs[i].geom),
+									 GridEntry{ShapeType::ARC, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.ixn_points.size(); i++) {
+		detail::insert(grid, bounds(shapes.ixn_points[i].P),
+									 GridEntry{ShapeType::IXN_POINT, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.def_points.size(); i++) {
+		detail::insert(grid, bounds(shapes.def_points[i].P),
+									 GridEntry{ShapeType::DEF_POINT, static_cast<uint32_t>(i)});
+	}
+	grid.built = true;
+}
+
+void collect_all(const Shapes &shapes,
+								 std::pmr::vector<GridEntry> &out) {
+	for (size_t i = 0; i < shapes.ixn_points.size(); i++) {
+		out.push_back(GridEntry{ShapeType::IXN_POINT, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.def_points.size(); i++) {
+		out.push_back(GridEntry{ShapeType::DEF_POINT, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.lines.size(); i++) {
+		out.push_back(GridEntry{ShapeType::LINE, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.circles.size(); i++) {
+		out.push_back(GridEntry{ShapeType::CIRCLE, static_cast<uint32_t>(i)});
+	}
+	for (size_t i = 0; i < shapes.arcs.size(); i++) {
+		out.push_back(GridEntry{ShapeType::ARC, static_cast<uint32_t>(i)});
+	}
+}
+
+void query(const ShapeGrid &grid, const Box &box,
+					std::pmr::vector<GridEntry> &out) {
+	size_t first = out.size();
+	int64_t x0 = detail::cell_of(box.min.x), x1 = detail::cell_of(box.max.x);
+	int64_t y0 = detail::cell_of(box.min.y), y1 = detail::cell_of(box.max.y);
+	double n_box_cells = static_cast<double>(x1 - x0 + 1) * (y1 - y0 + 1);
+	if (n_box_cells > static_cast<double>(grid.cells.size())) {
+		// zoomed far out, walking the occupied cells is cheaper
+		for (const auto &[key, entries] : grid.cells) {
+			int64_t cx = static_cast<int32_t>(key >> 32);
+			int64_t cy = static_cast<int32_t>(key & 0xFFFFFFFF);
+			if (cx >= x0 && cx <= x1 && cy >= y0 && cy <= y1) {
+				out.insert(out.end(), entries.begin(), entries.end());
+			}
+		}
+	} else {
+		for (int64_t cy = y0; cy <= y1; cy++) {
+			for (int64_t cx = x0; cx <= x1; cx++) {
+				auto iter = grid.cells.find(detail::cell_key(cx, cy));
+				if (iter != grid.cells.end()) {
+					out.insert(out.end(), iter->second.begin(), iter->second.end());
+				}
+			}
+		}
+	}
+	out.insert(out.end(), grid.oversized.begin(), grid.oversized.end());
+
+	// entries spanning several cells show up more than once
+	auto less = [](const GridEntry &a, const GridEntry &b) {
+		return a.type != b.type ? a.type < b.type : a.index < b.index;
+	};
+	auto equal = [](const GridEntry &a, const GridEntry &b) {
+		return a.type == b.type && a.index == b.index;
+	};
+	std::sort(out.begin() + first, out.end(), less);
+	out.erase(std::unique(out.begin() + first, out.end(), equal), out.end());
+}
+} // namespace spatial
@@ -0,0 +1,32 @@
+// spatial.hpp
+#pragma once
+#include "core.hpp"
+#include "graphics.hpp"
+#include "shapes.hpp"
+
+struct Box {
+	Vec2 min{}, max{};
+};
+
+namespace spatial {
+namespace detail {
+uint64_t cell_key(int64_t cx, int64_t cy);
+void insert(ShapeGrid &grid, const Box &box, GridEntry entry);
+} // namespace detail
+Box bounds(const Line2 &line);
+Box bounds(const Circle2 &circle);
+Box bounds(const Arc2 &arc);
+Box bounds(const Vec2 &P);
+bool overlap(const Box &a, const Box &b);
+// the ring of a circle touches the box, not only its disc
+bool ring_overlap(const Box &box, const Vec2 &C, double radius);
+
+void rebuild(ShapeGrid &grid, const Shapes &shapes);
+// every shape and node, same order as a query
+void collect_all(const Shapes &shapes,
+								 std::pmr::vector<GridEntry> &out);
+// append candidates whose cells overlap the box, sorted by type and index
+// without duplicates, entries still need an exact test
+void query(const ShapeGrid &grid, const Box &box,
+					std::pmr::vector<GridEntry> &out);
+} // namespace spatial
@@ -0,0 +1,86 @@
+// follows the first line of a save file through two edits with the
+// relation diff on, make test runs it on save_file
+#include "arena.hpp"
+#include "gen.hpp"
+#include "nodes.hpp"
+#include "serialize.hpp"
+
+// the line is lengthened twice, the relations a fresh gen line gives
+// before and after each edit are what the generation has to hold
+bool check_diff(const std::string &save_file, const std::string &path) {
+	Shapes shapes;
+	if (!serialize::load_appstate(shapes, save_file)) {
+		return false;
+	}
+	nodes::rebuild(shapes);
+	if (shapes.lines.size() == 0) {
+		std::cerr << "no line to follow in " << save_file << std::endl;
+		return false;
+	}
+	Line line = shapes.lines[0];
+	auto relations_now = [&]() {
+		GenLine fresh{line.id, line.geom.A, line.geom.A};
+		std::pmr::vector<double> values = gen::line_relations(shapes, fresh);
+		return std::vector<double>(values.begin(), values.end());
+	};
+	GenShapes gen_shapes;
+	gen_shapes.lines.push_back(GenLine{line.id, line.geom.A, line.geom.A});
+	gen_shapes.selection_order.emplace_back(ShapeType::LINE, 0);
+	RelationDiff diff;
+	if (!gen::start_diff(shapes, gen_shapes, diff, path)) {
+		return false;
+	}
+	std::vector<double> before = relations_now();
+
+	auto same = [](const RelationChange &a, const RelationChange &b) {
+		auto equal = [](const double x, const double y) {
+			return x == y || (std::isnan(x) && std::isnan(y));
+		};
+		return a.shape_id == b.shape_id && a.index == b.index &&
+					 equal(a.old_value, b.old_value) && equal(a.new_value, b.new_value);
+	};
+	for (int edit = 0; edit < 2; edit++) {
+		uint64_t generation = diff.generation;
+		// out of the store while it is edited, added back with the same id
+		shapes.edit.in_edit = true;
+		const Handle handle = shapes.by_id[line.id].handle;
+		shapes::remove_line(shapes, handle);
+		nodes::rebuild(shapes);
+		gen::update_diff(shapes, diff);
+		if (diff.generation != generation) {
+			std::cerr << "generation written during the edit" << std::endl;
+			return false;
+		}
+		line.geom.B = line.geom.B + (line.geom.B - line.geom.A) * 0.25;
+		shapes::add_line(shapes, line);
+		shapes.edit.in_edit = false;
+		nodes::rebuild(shapes);
+		gen::update_diff(shapes, diff);
+
+		std::vector<double> after = relations_now();
+		std::vector<RelationChange> expected;
+		gen::detail::diff_values(line.id, before, after, expected);
+		bool ok = diff.generation == generation + (expected.empty() ? 0 : 1) &&
+							diff.changes.size() == expected.size() &&
+							std::equal(expected.begin(), expected.end(),
+												 diff.changes.begin(), same);
+		if (!ok) {
+			std::cerr << "edit " << edit << ": " << diff.changes.size()
+				<< " changes, expected " << expected.size() << std::endl;
+			return false;
+		}
+		before = std::move(after);
+		arena::reset_frame();
+	}
+	gen::stop_diff(diff);
+	cout << "diff follows the edited line " << line.id << endl;
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " <save_file> <out.diff>" << std::endl;
+		return 1;
+	}
+	return check_diff(argv[1], argv[2]) ? 0 : 1;
+}